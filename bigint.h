@@ -0,0 +1,580 @@
+// bigint.h
+// Arbitrary-precision integers for the public-key experiments (exp10 DSA).
+//
+// A BigInt is a sign and a magnitude: a little-endian vector of 64-bit
+// limbs with no leading zero limbs (zero is the empty vector). Limb
+// products go through unsigned __int128. Multiplication is schoolbook below
+// KARATSUBA_THRESHOLD limbs and Karatsuba above it; division is Knuth's
+// algorithm D. The limb routines in namespace bigint work on plain arrays,
+// so code that does many operations on fixed-size numbers can call them
+// without allocating.
+#ifndef BIGINT_H
+#define BIGINT_H
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace bigint {
+
+typedef uint64_t Limb;
+typedef unsigned __int128 Wide;
+
+// Operand size in limbs from which Karatsuba is used (one level of it is
+// faster than schoolbook from about here on; see exp10 --bench)
+const size_t KARATSUBA_THRESHOLD = 24;
+
+// r[0, n) = a + b; returns the carry
+inline Limb add(Limb *r, const Limb *a, const Limb *b, size_t n) {
+    Limb carry = 0;
+    for (size_t i = 0; i < n; ++i) {
+        Wide s = Wide(a[i]) + b[i] + carry;
+        r[i] = Limb(s);
+        carry = Limb(s >> 64);
+    }
+    return carry;
+}
+
+// r[0, n) = a - b; returns the borrow
+inline Limb sub(Limb *r, const Limb *a, const Limb *b, size_t n) {
+    Limb borrow = 0;
+    for (size_t i = 0; i < n; ++i) {
+        Wide d = Wide(a[i]) - b[i] - borrow;
+        r[i] = Limb(d);
+        borrow = Limb(d >> 64) & 1;
+    }
+    return borrow;
+}
+
+// r[0, n) += c; returns the carry out of the top
+inline Limb addLimb(Limb *r, size_t n, Limb c) {
+    for (size_t i = 0; i < n && c; ++i) {
+        r[i] += c;
+        c = r[i] < c;
+    }
+    return c;
+}
+
+// r[0, n) -= c; returns the borrow out of the top
+inline Limb subLimb(Limb *r, size_t n, Limb c) {
+    for (size_t i = 0; i < n && c; ++i) {
+        Limb before = r[i];
+        r[i] -= c;
+        c = before < c;
+    }
+    return c;
+}
+
+// r[0, n) += a[0, n) * b; returns the limb carried out
+inline Limb mulAdd(Limb *r, const Limb *a, size_t n, Limb b) {
+    Limb carry = 0;
+    for (size_t i = 0; i < n; ++i) {
+        Wide t = Wide(a[i]) * b + r[i] + carry;
+        r[i] = Limb(t);
+        carry = Limb(t >> 64);
+    }
+    return carry;
+}
+
+// r[0, n) -= a[0, n) * b; returns the limb borrowed from above
+inline Limb mulSub(Limb *r, const Limb *a, size_t n, Limb b) {
+    Limb carry = 0;
+    for (size_t i = 0; i < n; ++i) {
+        Wide t = Wide(a[i]) * b + carry;
+        Limb low = Limb(t), before = r[i];
+        r[i] = before - low;
+        carry = Limb(t >> 64) + (before < low);
+    }
+    return carry;
+}
+
+// -1, 0 or 1 as a[0, n) is below, equal to or above b[0, n)
+inline int compare(const Limb *a, const Limb *b, size_t n) {
+    for (size_t i = n; i-- > 0;)
+        if (a[i] != b[i]) return a[i] < b[i] ? -1 : 1;
+    return 0;
+}
+
+// r[0, n) = a << s for 0 <= s < 64; returns the bits shifted out
+inline Limb shiftLeft(Limb *r, const Limb *a, size_t n, unsigned s) {
+    if (s == 0) {
+        std::copy(a, a + n, r);
+        return 0;
+    }
+    Limb out = 0;
+    for (size_t i = 0; i < n; ++i) {
+        Limb x = a[i];
+        r[i] = (x << s) | out;
+        out = x >> (64 - s);
+    }
+    return out;
+}
+
+// r[0, n) = a >> s for 0 <= s < 64
+inline void shiftRight(Limb *r, const Limb *a, size_t n, unsigned s) {
+    if (s == 0) {
+        std::copy(a, a + n, r);
+        return;
+    }
+    for (size_t i = 0; i < n; ++i)
+        r[i] = (a[i] >> s) | (i + 1 < n ? a[i + 1] << (64 - s) : 0);
+}
+
+// r[0, an + bn) = a * b; r must not overlap a or b
+inline void mulSchoolbook(Limb *r, const Limb *a, size_t an, const Limb *b, size_t bn) {
+    std::fill(r, r + an, 0);
+    for (size_t i = 0; i < bn; ++i) r[an + i] = mulAdd(r + i, a, an, b[i]);
+}
+
+// r[0, 2n) = a^2 with each cross product a[i] a[j] computed once and
+// doubled, then the squares a[i]^2 added; r must not overlap a
+inline void sqrSchoolbook(Limb *r, const Limb *a, size_t n) {
+    std::fill(r, r + 2 * n, 0);
+    for (size_t i = 0; i + 1 < n; ++i) r[i + n] = mulAdd(r + 2 * i + 1, a + i + 1, n - i - 1, a[i]);
+    shiftLeft(r, r, 2 * n, 1);
+    Limb carry = 0;
+    for (size_t i = 0; i < n; ++i) {
+        Wide d = Wide(a[i]) * a[i];
+        Wide s0 = Wide(r[2 * i]) + Limb(d) + carry;
+        Wide s1 = Wide(r[2 * i + 1]) + Limb(d >> 64) + Limb(s0 >> 64);
+        r[2 * i] = Limb(s0);
+        r[2 * i + 1] = Limb(s1);
+        carry = Limb(s1 >> 64);
+    }
+}
+
+// out[0, n) = |x - y| for x of xn and y of yn limbs (both at most n, zero
+// extended); true if x < y
+inline bool absDiff(Limb *out, const Limb *x, size_t xn, const Limb *y, size_t yn, size_t n) {
+    int cmp = 0;
+    for (size_t i = n; i-- > 0 && cmp == 0;) {
+        Limb xi = i < xn ? x[i] : 0, yi = i < yn ? y[i] : 0;
+        if (xi != yi) cmp = xi < yi ? -1 : 1;
+    }
+    if (cmp < 0) {
+        std::swap(x, y);
+        std::swap(xn, yn);
+    }
+    Limb borrow = 0;
+    for (size_t i = 0; i < n; ++i) {
+        Wide d = Wide(i < xn ? x[i] : 0) - (i < yn ? y[i] : 0) - borrow;
+        out[i] = Limb(d);
+        borrow = Limb(d >> 64) & 1;
+    }
+    return cmp < 0;
+}
+
+// Scratch limbs mulKaratsuba needs for n-limb operands: about 3n per
+// level, halving each time
+inline size_t karatsubaScratch(size_t n) {
+    return 6 * n + 8 * 64;
+}
+
+// r[0, 2n) = a * b for n-limb a and b. With a = a1 B^m + a0 and the same
+// for b, the middle term a0 b1 + a1 b0 is z0 + z2 + (a0 - a1)(b1 - b0), so
+// three half-size products replace four. The differences are taken as
+// magnitudes with a sign, which keeps every operand at ceil(n / 2) limbs.
+inline void mulKaratsuba(Limb *r, const Limb *a, const Limb *b, size_t n, Limb *scratch,
+                         size_t threshold = KARATSUBA_THRESHOLD) {
+    if (n < threshold || n < 4) {
+        mulSchoolbook(r, a, n, b, n);
+        return;
+    }
+    size_t m = n / 2, k = n - m;
+    Limb *da = scratch, *db = da + k, *d = db + k, *t = d + 2 * k, *next = t + 2 * k + 1;
+
+    mulKaratsuba(r, a, b, m, next, threshold);                  // z0 = a0 b0
+    mulKaratsuba(r + 2 * m, a + m, b + m, k, next, threshold);  // z2 = a1 b1
+    bool negative = absDiff(da, a, m, a + m, k, k) != absDiff(db, b + m, k, b, m, k);
+    mulKaratsuba(d, da, db, k, next, threshold);
+
+    // t = z0 + z2 +/- d, which is a0 b1 + a1 b0 and so never negative
+    std::copy(r, r + 2 * m, t);
+    std::fill(t + 2 * m, t + 2 * k + 1, 0);
+    t[2 * k] = add(t, t, r + 2 * m, 2 * k);
+    if (negative) t[2 * k] -= sub(t, t, d, 2 * k);
+    else t[2 * k] += add(t, t, d, 2 * k);
+
+    Limb carry = add(r + m, r + m, t, 2 * k + 1);
+    addLimb(r + m + 2 * k + 1, m - 1, carry);
+}
+
+// r[0, an + bn) = a * b for any sizes; r must not overlap a or b. An
+// unbalanced product is done as balanced products of the longer operand's
+// pieces.
+inline void multiply(Limb *r, const Limb *a, size_t an, const Limb *b, size_t bn,
+                     size_t threshold = KARATSUBA_THRESHOLD) {
+    if (an < bn) {
+        std::swap(a, b);
+        std::swap(an, bn);
+    }
+    if (bn < threshold || bn < 4) {
+        mulSchoolbook(r, a, an, b, bn);
+        return;
+    }
+    std::vector<Limb> scratch(karatsubaScratch(bn) + 2 * bn);
+    if (an == bn) {
+        mulKaratsuba(r, a, b, bn, scratch.data(), threshold);
+        return;
+    }
+    Limb *product = scratch.data() + karatsubaScratch(bn);
+    std::fill(r, r + an + bn, 0);
+    for (size_t off = 0; off < an; off += bn) {
+        size_t piece = std::min(bn, an - off);
+        if (piece == bn) mulKaratsuba(product, a + off, b, bn, scratch.data(), threshold);
+        else multiply(product, b, bn, a + off, piece, threshold);
+        Limb carry = add(r + off, r + off, product, bn + piece);
+        addLimb(r + off + bn + piece, an - off - piece, carry);
+    }
+}
+
+// q[0, n) = u / d; returns u % d
+inline Limb divLimb(Limb *q, const Limb *u, size_t n, Limb d) {
+    Limb rem = 0;
+    for (size_t i = n; i-- > 0;) {
+        Wide cur = (Wide(rem) << 64) | u[i];
+        q[i] = Limb(cur / d);
+        rem = Limb(cur % d);
+    }
+    return rem;
+}
+
+// Knuth's algorithm D: q[0, un - vn + 1) = u / v and r[0, vn) = u % v for
+// un >= vn >= 2 and v[vn - 1] != 0. Each quotient limb is estimated from
+// the top two limbs of the remainder and the divisor (normalized so its top
+// bit is set), corrected with the next divisor limb, and is then off by at
+// most one, which a final add-back fixes.
+inline void divide(Limb *q, Limb *r, const Limb *u, size_t un, const Limb *v, size_t vn) {
+    unsigned s = __builtin_clzll(v[vn - 1]);
+    std::vector<Limb> vs(vn), us(un + 1);
+    shiftLeft(vs.data(), v, vn, s);
+    us[un] = shiftLeft(us.data(), u, un, s);
+    const Limb top = vs[vn - 1], second = vs[vn - 2];
+
+    for (size_t j = un - vn + 1; j-- > 0;) {
+        Wide num = (Wide(us[j + vn]) << 64) | us[j + vn - 1];
+        Wide qhat = num / top, rhat = num % top;
+        while ((qhat >> 64) || qhat * second > ((rhat << 64) | us[j + vn - 2])) {
+            --qhat;
+            rhat += top;
+            if (rhat >> 64) break;
+        }
+        Limb borrow = mulSub(us.data() + j, vs.data(), vn, Limb(qhat));
+        Limb high = us[j + vn];
+        us[j + vn] = high - borrow;
+        if (high < borrow) {
+            --qhat;
+            us[j + vn] += add(us.data() + j, us.data() + j, vs.data(), vn);
+        }
+        q[j] = Limb(qhat);
+    }
+    shiftRight(r, us.data(), vn, s);
+}
+
+} // namespace bigint
+
+class BigInt {
+public:
+    typedef bigint::Limb Limb;
+
+    BigInt() {}
+
+    BigInt(long long v) : negative(v < 0) {
+        unsigned long long m = v < 0 ? 0ULL - (unsigned long long)v : (unsigned long long)v;
+        if (m) mag.push_back(m);
+    }
+
+    static BigInt fromU64(uint64_t v) {
+        BigInt x;
+        if (v) x.mag.push_back(v);
+        return x;
+    }
+
+    // From little-endian limbs (leading zeros are fine)
+    static BigInt fromLimbs(const Limb *limbs, size_t n, bool negative = false) {
+        BigInt x;
+        x.mag.assign(limbs, limbs + n);
+        x.negative = negative;
+        x.trim();
+        return x;
+    }
+
+    // Uniform in [0, 2^bits) from a 64-bit generator such as std::mt19937_64
+    template <typename Rng>
+    static BigInt random(size_t bits, Rng &rng) {
+        BigInt x;
+        x.mag.resize((bits + 63) / 64);
+        for (Limb &l : x.mag) l = rng();
+        if (bits % 64) x.mag.back() &= (Limb(1) << (bits % 64)) - 1;
+        x.trim();
+        return x;
+    }
+
+    // Decimal, or hex after "0x"; optional leading '-'. False (and out
+    // unchanged) on anything else.
+    static bool parse(const std::string &s, BigInt &out) {
+        size_t i = 0;
+        bool neg = false;
+        if (i < s.size() && (s[i] == '-' || s[i] == '+')) neg = s[i++] == '-';
+        bool hex = s.compare(i, 2, "0x") == 0 || s.compare(i, 2, "0X") == 0;
+        if (hex) i += 2;
+        if (i == s.size()) return false;
+
+        BigInt x;
+        if (hex) {
+            size_t digits = s.size() - i;
+            x.mag.assign((digits + 15) / 16, 0);
+            for (size_t d = 0; d < digits; ++d) {
+                char c = s[s.size() - 1 - d];
+                int v = c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10
+                      : c >= 'A' && c <= 'F' ? c - 'A' + 10 : -1;
+                if (v < 0) return false;
+                x.mag[d / 16] |= Limb(v) << (4 * (d % 16));
+            }
+        } else {
+            // 19 decimal digits at a time: x = x * 10^k + chunk
+            for (; i < s.size();) {
+                size_t k = std::min<size_t>(19, s.size() - i);
+                Limb chunk = 0, scale = 1;
+                for (size_t d = 0; d < k; ++d, ++i) {
+                    if (s[i] < '0' || s[i] > '9') return false;
+                    chunk = chunk * 10 + Limb(s[i] - '0');
+                    scale *= 10;
+                }
+                Limb carry = 0;
+                for (Limb &l : x.mag) {
+                    bigint::Wide t = bigint::Wide(l) * scale + carry;
+                    l = Limb(t);
+                    carry = Limb(t >> 64);
+                }
+                if (carry) x.mag.push_back(carry);
+                if (x.mag.empty()) x.mag.push_back(0);
+                if (bigint::addLimb(x.mag.data(), x.mag.size(), chunk)) x.mag.push_back(1);
+            }
+        }
+        x.negative = neg;
+        x.trim();
+        out = std::move(x);
+        return true;
+    }
+
+    std::string toString() const {
+        if (mag.empty()) return "0";
+        const Limb chunk = 10000000000000000000ULL; // 10^19
+        std::vector<Limb> rest(mag);
+        std::vector<Limb> parts;
+        while (!rest.empty()) {
+            parts.push_back(bigint::divLimb(rest.data(), rest.data(), rest.size(), chunk));
+            while (!rest.empty() && rest.back() == 0) rest.pop_back();
+        }
+        std::string s = negative ? "-" : "";
+        s += std::to_string(parts.back());
+        for (size_t i = parts.size() - 1; i-- > 0;) {
+            std::string digits = std::to_string(parts[i]);
+            s += std::string(19 - digits.size(), '0') + digits;
+        }
+        return s;
+    }
+
+    // Lower-case hex with a 0x prefix
+    std::string toHex() const {
+        if (mag.empty()) return "0x0";
+        static const char digits[] = "0123456789abcdef";
+        std::string s = negative ? "-0x" : "0x";
+        bool leading = true;
+        for (size_t i = mag.size(); i-- > 0;)
+            for (int d = 15; d >= 0; --d) {
+                int v = int(mag[i] >> (4 * d)) & 15;
+                if (leading && v == 0) continue;
+                leading = false;
+                s += digits[v];
+            }
+        return s;
+    }
+
+    bool isZero() const { return mag.empty(); }
+    bool isNegative() const { return negative; }
+    bool isOdd() const { return !mag.empty() && (mag[0] & 1); }
+    size_t limbCount() const { return mag.size(); }
+    const std::vector<Limb> &limbs() const { return mag; }
+
+    // Low 64 bits of the magnitude
+    uint64_t low64() const { return mag.empty() ? 0 : mag[0]; }
+
+    size_t bitLength() const {
+        return mag.empty() ? 0 : 64 * mag.size() - __builtin_clzll(mag.back());
+    }
+
+    bool testBit(size_t i) const {
+        return i / 64 < mag.size() && (mag[i / 64] >> (i % 64) & 1);
+    }
+
+    BigInt abs() const {
+        BigInt x = *this;
+        x.negative = false;
+        return x;
+    }
+
+    // -1, 0 or 1 comparing |a| with |b|
+    static int compareMagnitude(const BigInt &a, const BigInt &b) {
+        if (a.mag.size() != b.mag.size()) return a.mag.size() < b.mag.size() ? -1 : 1;
+        return bigint::compare(a.mag.data(), b.mag.data(), a.mag.size());
+    }
+
+    friend int compare(const BigInt &a, const BigInt &b) {
+        if (a.negative != b.negative) return a.negative ? -1 : 1;
+        int c = compareMagnitude(a, b);
+        return a.negative ? -c : c;
+    }
+
+    friend bool operator==(const BigInt &a, const BigInt &b) { return a.negative == b.negative && a.mag == b.mag; }
+    friend bool operator!=(const BigInt &a, const BigInt &b) { return !(a == b); }
+    friend bool operator<(const BigInt &a, const BigInt &b) { return compare(a, b) < 0; }
+    friend bool operator<=(const BigInt &a, const BigInt &b) { return compare(a, b) <= 0; }
+    friend bool operator>(const BigInt &a, const BigInt &b) { return compare(a, b) > 0; }
+    friend bool operator>=(const BigInt &a, const BigInt &b) { return compare(a, b) >= 0; }
+
+    BigInt operator-() const {
+        BigInt x = *this;
+        if (!x.mag.empty()) x.negative = !x.negative;
+        return x;
+    }
+
+    friend BigInt operator+(const BigInt &a, const BigInt &b) { return addSigned(a, b, b.negative); }
+    friend BigInt operator-(const BigInt &a, const BigInt &b) { return addSigned(a, b, !b.negative); }
+
+    friend BigInt operator*(const BigInt &a, const BigInt &b) {
+        BigInt x;
+        if (a.mag.empty() || b.mag.empty()) return x;
+        x.mag.resize(a.mag.size() + b.mag.size());
+        bigint::multiply(x.mag.data(), a.mag.data(), a.mag.size(), b.mag.data(), b.mag.size());
+        x.negative = a.negative != b.negative;
+        x.trim();
+        return x;
+    }
+
+    // Truncating division like the built-in types: q = a / b rounded
+    // toward zero and r = a - q b, which has the sign of a
+    static void divMod(const BigInt &a, const BigInt &b, BigInt &q, BigInt &r) {
+        if (b.mag.empty()) throw std::domain_error("BigInt division by zero");
+        BigInt quot, rem;
+        if (compareMagnitude(a, b) >= 0) {
+            size_t un = a.mag.size(), vn = b.mag.size();
+            quot.mag.resize(un - vn + 1);
+            if (vn == 1) {
+                Limb r1 = bigint::divLimb(quot.mag.data(), a.mag.data(), un, b.mag[0]);
+                if (r1) rem.mag.push_back(r1);
+            } else {
+                rem.mag.resize(vn);
+                bigint::divide(quot.mag.data(), rem.mag.data(), a.mag.data(), un, b.mag.data(), vn);
+            }
+            quot.negative = a.negative != b.negative;
+            rem.negative = a.negative;
+            quot.trim();
+            rem.trim();
+        } else {
+            rem = a;
+        }
+        q = std::move(quot);
+        r = std::move(rem);
+    }
+
+    friend BigInt operator/(const BigInt &a, const BigInt &b) {
+        BigInt q, r;
+        divMod(a, b, q, r);
+        return q;
+    }
+
+    friend BigInt operator%(const BigInt &a, const BigInt &b) {
+        BigInt q, r;
+        divMod(a, b, q, r);
+        return r;
+    }
+
+    // Shifts move the magnitude and keep the sign
+    friend BigInt operator<<(const BigInt &a, size_t bits) {
+        BigInt x;
+        if (a.mag.empty()) return x;
+        size_t limbs = bits / 64;
+        x.mag.assign(a.mag.size() + limbs + 1, 0);
+        x.mag.back() = bigint::shiftLeft(x.mag.data() + limbs, a.mag.data(), a.mag.size(), bits % 64);
+        x.negative = a.negative;
+        x.trim();
+        return x;
+    }
+
+    friend BigInt operator>>(const BigInt &a, size_t bits) {
+        BigInt x;
+        size_t limbs = bits / 64;
+        if (limbs >= a.mag.size()) return x;
+        x.mag.resize(a.mag.size() - limbs);
+        bigint::shiftRight(x.mag.data(), a.mag.data() + limbs, x.mag.size(), bits % 64);
+        x.negative = a.negative;
+        x.trim();
+        return x;
+    }
+
+    BigInt &operator+=(const BigInt &b) { return *this = *this + b; }
+    BigInt &operator-=(const BigInt &b) { return *this = *this - b; }
+    BigInt &operator*=(const BigInt &b) { return *this = *this * b; }
+    BigInt &operator/=(const BigInt &b) { return *this = *this / b; }
+    BigInt &operator%=(const BigInt &b) { return *this = *this % b; }
+    BigInt &operator<<=(size_t bits) { return *this = *this << bits; }
+    BigInt &operator>>=(size_t bits) { return *this = *this >> bits; }
+
+    friend std::ostream &operator<<(std::ostream &os, const BigInt &x) {
+        return os << ((os.flags() & std::ios::hex) ? x.toHex() : x.toString());
+    }
+
+    friend std::istream &operator>>(std::istream &is, BigInt &x) {
+        std::string token;
+        if (is >> token && !parse(token, x)) is.setstate(std::ios::failbit);
+        return is;
+    }
+
+private:
+    std::vector<Limb> mag;
+    bool negative = false;
+
+    void trim() {
+        while (!mag.empty() && mag.back() == 0) mag.pop_back();
+        if (mag.empty()) negative = false;
+    }
+
+    // a + b, with b's sign taken as bNegative
+    static BigInt addSigned(const BigInt &a, const BigInt &b, bool bNegative) {
+        const BigInt *big = &a, *small = &b;
+        bool bigNeg = a.negative, smallNeg = bNegative;
+        if (compareMagnitude(a, b) < 0) {
+            std::swap(big, small);
+            std::swap(bigNeg, smallNeg);
+        }
+        size_t n = big->mag.size(), m = small->mag.size();
+        BigInt x;
+        x.mag.assign(big->mag.begin(), big->mag.end());
+        if (bigNeg == smallNeg) {
+            x.mag.push_back(0);
+            Limb carry = bigint::add(x.mag.data(), x.mag.data(), small->mag.data(), m);
+            bigint::addLimb(x.mag.data() + m, n + 1 - m, carry);
+        } else {
+            Limb borrow = bigint::sub(x.mag.data(), x.mag.data(), small->mag.data(), m);
+            bigint::subLimb(x.mag.data() + m, n - m, borrow);
+        }
+        x.negative = bigNeg;
+        x.trim();
+        return x;
+    }
+};
+
+// a mod m in [0, m) for m > 0, whatever the sign of a
+inline BigInt mod(const BigInt &a, const BigInt &m) {
+    BigInt r = a % m;
+    if (r.isNegative()) r += m;
+    return r;
+}
+
+#endif
@@ -1,48 +1,245 @@
-// experiment 1 
+// experiment 1
 // To implement Caesar cipher encryption
 // Encryption: Replace each plaintext letter with one a Fixed number of
 // places down the alphabet.
 // Decryption: Replace each cipher text letter with one a fixed number of
 // places up the alphabet.
+//
+// Streaming mode (for inputs too large to hold in memory):
+//   ./exp1 -e <shift> [infile [outfile]]    encrypt file/stdin to file/stdout
+//   ./exp1 -d <shift> [infile [outfile]]    decrypt file/stdin to file/stdout
+//   ./exp1 --bench [MiB]                     throughput benchmark
 #include <iostream>
 #include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include "shift_kernel.h"
+#include "parallel_chunks.h"
 using namespace std;
 
-// Encrypt a message using Caesar Cipher
-string encrypt(string text, int shift) {
-    string result = "";
+// Size of the sample text the benchmark cycles through
+const size_t SAMPLE_SIZE = 1 << 20;
+
+// Bring any shift value into the range [0, 26)
+int normalizeShift(int shift) {
+    return ((shift % 26) + 26) % 26;
+}
 
-    for (char c : text) {
+// Straightforward per-character version, kept as the reference the
+// vectorized kernel is checked against. shift must be in [0, 26).
+void caesarReference(char *buf, size_t len, int shift) {
+    for (size_t i = 0; i < len; i++) {
+        char c = buf[i];
         if (isupper(c)) {
-            result += char((c - 'A' + shift) % 26 + 'A');
+            buf[i] = char((c - 'A' + shift) % 26 + 'A');
         } else if (islower(c)) {
-            result += char((c - 'a' + shift) % 26 + 'a');
-        } else {
-            result += c; // leave non-alphabet characters unchanged
-        }
+            buf[i] = char((c - 'a' + shift) % 26 + 'a');
+        } // leave non-alphabet characters unchanged
     }
+}
 
-    return result;
+// Shift every letter of buf[0..len) in place. shift must be in [0, 26).
+void caesarInPlace(char *buf, size_t len, int shift) {
+    shiftkernel::shiftUniform(buf, buf, len, shift);
+}
+
+// Encrypt a message using Caesar Cipher
+string encrypt(string text, int shift) {
+    // text is our own copy, so transform it in place
+    caesarInPlace(&text[0], text.size(), normalizeShift(shift));
+    return text;
 }
 
 // Decrypt a message using Caesar Cipher
 string decrypt(string text, int shift) {
-    string result = "";
+    caesarInPlace(&text[0], text.size(), normalizeShift(-shift));
+    return text;
+}
 
-    for (char c : text) {
-        if (isupper(c)) {
-            result += char((c - 'A' - shift + 26) % 26 + 'A');
-        } else if (islower(c)) {
-            result += char((c - 'a' - shift + 26) % 26 + 'a');
-        } else {
-            result += c;
+// Transform everything from in to out through one fixed-size batch buffer,
+// split into chunks that the pool shifts in parallel. Returns false on a
+// read or write error.
+bool caesarStream(FILE *in, FILE *out, int shift, ChunkPool &pool = ChunkPool::shared()) {
+    shift = normalizeShift(shift);
+    return streamChunks(in, out, pool, PARALLEL_CHUNK_SIZE, [shift](char *data, size_t len) {
+        caesarInPlace(data, len, shift);
+    });
+}
+
+// Fill buf with pseudo-random text that looks roughly like a log file
+void fillSampleText(char *buf, size_t len) {
+    const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz"
+                            "abcdefghijklmnopqrstuvwxyz0123456789 :./-_[]\n";
+    unsigned int seed = 12345;
+    for (size_t i = 0; i < len; i++) {
+        seed = seed * 1103515245 + 12345;
+        buf[i] = alphabet[(seed >> 16) % (sizeof(alphabet) - 1)];
+    }
+}
+
+double secondsSince(chrono::steady_clock::time_point start) {
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+// Compare every kernel backend with caesarReference on all 256 byte values
+// and a sample text, for every shift. Returns false on the first mismatch.
+bool checkKernels(const vector<char> &sample) {
+    vector<char> input(sample);
+    for (int c = 0; c < 256; c++) input.push_back(char(c));
+
+    for (int b = shiftkernel::Scalar; b <= shiftkernel::AVX2; b++) {
+        auto backend = shiftkernel::Backend(b);
+        if (!shiftkernel::supported(backend)) continue;
+        for (int shift = 0; shift < 26; shift++) {
+            vector<char> expected(input), actual(input.size());
+            caesarReference(expected.data(), expected.size(), shift);
+            shiftkernel::shiftUniform(backend, input.data(), actual.data(), input.size(), shift);
+            if (actual != expected) {
+                cout << "Mismatch: " << shiftkernel::backendName(backend)
+                     << " kernel, shift " << shift << "\n";
+                return false;
+            }
         }
     }
+    return true;
+}
+
+// Report MB/s for the string API, the reference loop, each kernel backend,
+// the file stream and the parallel driver from 1 to N threads
+int runBenchmark(size_t mib) {
+    size_t total = mib << 20;
+    vector<char> sample(SAMPLE_SIZE);
+    fillSampleText(sample.data(), sample.size());
+    if (!checkKernels(sample)) return 1;
+
+    // String API over the whole input at once
+    string text(total, ' ');
+    for (size_t off = 0; off < total; off += sample.size())
+        memcpy(&text[off], sample.data(), min(sample.size(), total - off));
+    auto start = chrono::steady_clock::now();
+    string enc = encrypt(text, 3);
+    double tString = secondsSince(start);
+    if (decrypt(enc, 3) != text) {
+        cout << "Round trip through encrypt/decrypt failed\n";
+        return 1;
+    }
+    text.clear();
+    text.shrink_to_fit();
+    enc.clear();
+    enc.shrink_to_fit();
 
-    return result;
+    // Reference loop and each kernel backend over one reusable buffer
+    double mb = double(total) / (1 << 20);
+    vector<char> buf(SAMPLE_SIZE);
+    start = chrono::steady_clock::now();
+    for (size_t done = 0; done < total; done += buf.size()) {
+        memcpy(buf.data(), sample.data(), buf.size());
+        caesarReference(buf.data(), buf.size(), 3);
+    }
+    double tReference = secondsSince(start);
+
+    cout << "Caesar throughput over " << mib << " MiB\n";
+    cout << "  encrypt(string)       : " << mb / tString << " MB/s\n";
+    cout << "  reference loop        : " << mb / tReference << " MB/s\n";
+    for (int b = shiftkernel::Scalar; b <= shiftkernel::AVX2; b++) {
+        auto backend = shiftkernel::Backend(b);
+        if (!shiftkernel::supported(backend)) continue;
+        start = chrono::steady_clock::now();
+        for (size_t done = 0; done < total; done += buf.size()) {
+            memcpy(buf.data(), sample.data(), buf.size());
+            shiftkernel::shiftUniform(backend, buf.data(), buf.data(), buf.size(), 3);
+        }
+        double t = secondsSince(start);
+        string label = string("kernel (") + shiftkernel::backendName(backend) + ")";
+        label.resize(22, ' ');
+        cout << "  " << label << ": " << mb / t << " MB/s\n";
+    }
+
+    // Full stream: temporary file in, temporary file out
+    FILE *in = tmpfile();
+    FILE *out = tmpfile();
+    if (!in || !out) {
+        cout << "Could not create temporary files\n";
+        return 1;
+    }
+    for (size_t done = 0; done < total; done += sample.size())
+        fwrite(sample.data(), 1, min(sample.size(), total - done), in);
+    rewind(in);
+    start = chrono::steady_clock::now();
+    bool ok = caesarStream(in, out, 3);
+    double tStream = secondsSince(start);
+    fclose(in);
+    fclose(out);
+    if (!ok) {
+        cout << "Stream benchmark failed\n";
+        return 1;
+    }
+
+    cout << "  stream file -> file   : " << mb / tStream << " MB/s\n";
+
+    // Scaling of the chunked parallel driver over one in-memory buffer
+    vector<char> big(total);
+    for (size_t off = 0; off < total; off += sample.size())
+        memcpy(&big[off], sample.data(), min(sample.size(), total - off));
+    double tOne = 0;
+    cout << "Parallel scaling (" << PARALLEL_CHUNK_SIZE / 1024 << " KiB chunks)\n";
+    for (unsigned threads : scalingThreadCounts()) {
+        ChunkPool pool(threads);
+        start = chrono::steady_clock::now();
+        pool.run(total, PARALLEL_CHUNK_SIZE, 1, [&](size_t b, size_t e) {
+            caesarInPlace(&big[b], e - b, 3);
+        });
+        double t = secondsSince(start);
+        if (threads == 1) tOne = t;
+        cout << "  " << threads << " thread(s)          : " << mb / t << " MB/s, speedup " << tOne / t << "x\n";
+    }
+    return 0;
+}
+
+// Handle the non-interactive modes. Returns -1 if argv is not one of them.
+int runCommandLine(int argc, char *argv[]) {
+    string mode = argv[1];
+
+    if (mode == "--bench") {
+        size_t mib = argc > 2 ? strtoul(argv[2], nullptr, 10) : 256;
+        return runBenchmark(mib ? mib : 256);
+    }
+
+    if ((mode == "-e" || mode == "-d") && argc >= 3) {
+        int shift = atoi(argv[2]);
+        if (mode == "-d") shift = -shift;
+
+        FILE *in = stdin, *out = stdout;
+        if (argc > 3 && !(in = fopen(argv[3], "rb"))) {
+            cerr << "Cannot open " << argv[3] << "\n";
+            return 1;
+        }
+        if (argc > 4 && !(out = fopen(argv[4], "wb"))) {
+            cerr << "Cannot open " << argv[4] << "\n";
+            return 1;
+        }
+
+        bool ok = caesarStream(in, out, shift);
+        if (in != stdin) fclose(in);
+        if (out != stdout && fclose(out) != 0) ok = false;
+        if (!ok) cerr << "I/O error while streaming\n";
+        return ok ? 0 : 1;
+    }
+
+    return -1;
 }
 
-int main() {
+int main(int argc, char *argv[]) {
+    if (argc > 1) {
+        int status = runCommandLine(argc, argv);
+        if (status >= 0) return status;
+        cerr << "Usage: " << argv[0] << " [-e|-d <shift> [infile [outfile]] | --bench [MiB]]\n";
+        return 1;
+    }
+
     string text;
     int shift, choice;
 
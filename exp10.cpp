@@ -1,69 +1,58 @@
 //10. implement a digital signature algorithm
+//
+//   ./exp10 [PARAMFILE]       interactive; keys use PARAMFILE (default
+//                             dsa.params) if it exists, toy parameters if not
+//   ./exp10 --params L N [PARAMFILE]   generate (L, N) = (2048, 224),
+//                             (2048, 256), (3072, 256) or (1024, 160)
+//                             parameters once
+//   ./exp10 --bench           BigInt and modexp checks, per-operation timings
+//                             (256-4096 bits), exponentiations/s and
+//                             signatures/s with and without the g table,
+//                             verifications/s by each joint path
 #include <iostream>
 #include <string>
 #include <cmath>
-#include <ctime>
 #include <sstream>
 #include <iomanip>
 #include <vector>
-
-// Simple big integer class for DSA operations (limited to 64-bit for simplicity)
-class BigInt {
-public:
-    long long value;
-    
-    BigInt(long long v = 0) : value(v) {}
-    
-    BigInt operator+(const BigInt& other) const {
-        return BigInt(value + other.value);
-    }
-    
-    BigInt operator-(const BigInt& other) const {
-        return BigInt(value - other.value);
-    }
-    
-    BigInt operator*(const BigInt& other) const {
-        return BigInt(value * other.value);
-    }
-    
-    BigInt operator%(const BigInt& other) const {
-        return BigInt(value % other.value);
-    }
-    
-    bool operator==(const BigInt& other) const {
-        return value == other.value;
-    }
-    
-    bool operator<(const BigInt& other) const {
-        return value < other.value;
-    }
-};
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <list>
+#include <map>
+#include <random>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifndef _WIN32
+#define DSA_MMAP 1
+#include <sys/mman.h>
+#endif
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+#include "bigint.h"
+#include "modexp.h"
+#include "primes.h"
 
 // Modular exponentiation: (base^exp) % mod
-long long modPow(long long base, long long exp, long long mod) {
-    long long result = 1;
-    base = base % mod;
-    
-    while (exp > 0) {
-        if (exp % 2 == 1) {
-            result = (result * base) % mod;
-        }
-        exp = exp >> 1;
-        base = (base * base) % mod;
-    }
-    
-    return result;
+BigInt modPow(const BigInt& base, const BigInt& exp, const BigInt& mod) {
+    return modexp::powMod(base, exp, mod);
 }
 
 // Extended Euclidean Algorithm for modular inverse
-long long modInverse(long long a, long long m) {
-    long long m0 = m, x0 = 0, x1 = 1;
+BigInt modInverse(BigInt a, BigInt m) {
+    BigInt m0 = m, x0 = 0, x1 = 1;
     
     if (m == 1) return 0;
     
     while (a > 1) {
-        long long q = a / m;
-        long long t = m;
+        BigInt q = a / m;
+        BigInt t = m;
         
         m = a % m;
         a = t;
@@ -78,18 +67,10 @@ long long modInverse(long long a, long long m) {
     return x1;
 }
 
-// Simple primality test (Miller-Rabin would be better for production)
-bool isPrime(long long n) {
-    if (n <= 1) return false;
-    if (n <= 3) return true;
-    if (n % 2 == 0 || n % 3 == 0) return false;
-    
-    for (long long i = 5; i * i <= n; i += 6) {
-        if (n % i == 0 || n % (i + 2) == 0)
-            return false;
-    }
-    
-    return true;
+// Trial division, then Miller-Rabin (exact below 2^64)
+bool isPrime(const BigInt& n) {
+    static primes::SystemRandom rng;
+    return primes::isProbablePrime(n, rng);
 }
 
 // Simple hash function (in production, use SHA-256)
@@ -101,96 +82,311 @@ long long simpleHash(const std::string& message) {
     return hash;
 }
 
+// ---------------------------------------------------------------------------
+// Domain parameters at standard sizes, FIPS 186-style: a random N-bit prime
+// q, an L-bit prime p = k q + 1 and g = h^((p - 1) / q) mod p of order q.
+// The search takes seconds, so it runs only for --params and the result is
+// kept in a file that later runs map and read in a millisecond or so.
+
+struct DomainParameters {
+    size_t L = 0, N = 0;
+    BigInt p, q, g;
+};
+
+// The (L, N) pairs of FIPS 186-4
+bool standardSizes(size_t L, size_t N) {
+    return (L == 1024 && N == 160) || (L == 2048 && (N == 224 || N == 256)) || (L == 3072 && N == 256);
+}
+
+// The first h = 2, 3, ... with h^((p - 1) / q) != 1 gives a generator of
+// the order-q subgroup; h = 2 almost always does
+BigInt subgroupGenerator(const modexp::Modulus& pMod, const BigInt& p, const BigInt& q) {
+    BigInt e = (p - 1) / q;
+    for (BigInt h = 2; h < p - 1; h += 1) {
+        BigInt g = pMod.pow(h, e);
+        if (g > 1) return g;
+    }
+    return 0;
+}
+
+DomainParameters generateParameters(size_t L, size_t N) {
+    primes::SystemRandom rng;
+    DomainParameters dp;
+    dp.L = L;
+    dp.N = N;
+    dp.q = primes::randomPrime(N, rng);
+    dp.p = primes::randomPrimeOneMod(L, dp.q * 2, rng);
+    dp.g = subgroupGenerator(modexp::Modulus(dp.p), dp.p, dp.q);
+    return dp;
+}
+
+// Sizes and the relations between p, q and g (g of order exactly q);
+// primality is not re-tested, which is what keeps loading fast
+bool checkParameters(const DomainParameters& dp) {
+    return standardSizes(dp.L, dp.N) && dp.p.bitLength() == dp.L && dp.q.bitLength() == dp.N &&
+           (dp.p - 1) % dp.q == 0 && dp.g > 1 && dp.g < dp.p && modPow(dp.g, dp.q, dp.p) == 1;
+}
+
+// Parameter file: "EXP10DP1", L and N as little-endian 64-bit words, then
+// p, q and g as L / 64, ceil(N / 64) and L / 64 little-endian 64-bit limbs
+const char PARAMS_MAGIC[8] = {'E', 'X', 'P', '1', '0', 'D', 'P', '1'};
+const char* const DEFAULT_PARAMS_FILE = "dsa.params";
+
+size_t paramsFileSize(size_t L, size_t N) {
+    return 8 * (3 + 2 * (L / 64) + (N + 63) / 64);
+}
+
+void putWord(std::vector<unsigned char>& out, uint64_t v) {
+    for (int i = 0; i < 8; i++) out.push_back((v >> (8 * i)) & 0xFF);
+}
+
+uint64_t getWord(const unsigned char* b) {
+    uint64_t v = 0;
+    for (int i = 0; i < 8; i++) v |= uint64_t(b[i]) << (8 * i);
+    return v;
+}
+
+void putLimbs(std::vector<unsigned char>& out, const BigInt& x, size_t count) {
+    for (size_t i = 0; i < count; i++) putWord(out, i < x.limbCount() ? x.limbs()[i] : 0);
+}
+
+BigInt getLimbs(const unsigned char*& b, size_t count) {
+    std::vector<uint64_t> limbs(count);
+    for (size_t i = 0; i < count; i++, b += 8) limbs[i] = getWord(b);
+    return BigInt::fromLimbs(limbs.data(), count);
+}
+
+// Written through a temporary file and renamed, so a reader never sees a
+// half-written set
+bool saveParameters(const std::string& path, const DomainParameters& dp) {
+    std::vector<unsigned char> out(PARAMS_MAGIC, PARAMS_MAGIC + 8);
+    putWord(out, dp.L);
+    putWord(out, dp.N);
+    putLimbs(out, dp.p, dp.L / 64);
+    putLimbs(out, dp.q, (dp.N + 63) / 64);
+    putLimbs(out, dp.g, dp.L / 64);
+    std::string tmp = path + ".tmp";
+    {
+        std::ofstream file(tmp, std::ios::binary | std::ios::trunc);
+        if (!file.write(reinterpret_cast<const char*>(out.data()), out.size()).flush()) return false;
+    }
+    return std::rename(tmp.c_str(), path.c_str()) == 0;
+}
+
+bool parseParameters(const unsigned char* data, size_t size, DomainParameters& dp) {
+    if (size < 24 || std::memcmp(data, PARAMS_MAGIC, 8) != 0) return false;
+    dp.L = size_t(getWord(data + 8));
+    dp.N = size_t(getWord(data + 16));
+    if (!standardSizes(dp.L, dp.N) || size != paramsFileSize(dp.L, dp.N)) return false;
+    const unsigned char* b = data + 24;
+    dp.p = getLimbs(b, dp.L / 64);
+    dp.q = getLimbs(b, (dp.N + 63) / 64);
+    dp.g = getLimbs(b, dp.L / 64);
+    return checkParameters(dp);
+}
+
+// Map the file (read it where mmap is missing) and parse it in place
+bool loadParameters(const std::string& path, DomainParameters& dp) {
+    int fd = open(path.c_str(), O_RDONLY | O_BINARY);
+    if (fd < 0) return false;
+    struct stat st;
+    bool ok = fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0;
+    size_t size = ok ? size_t(st.st_size) : 0;
+#ifdef DSA_MMAP
+    if (ok) {
+        void* map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (map == MAP_FAILED) return false;
+        ok = parseParameters(static_cast<const unsigned char*>(map), size, dp);
+        munmap(map, size);
+        return ok;
+    }
+#endif
+    std::vector<unsigned char> data(size);
+    ok = ok && read(fd, data.data(), size) == ssize_t(size);
+    close(fd);
+    return ok && parseParameters(data.data(), size, dp);
+}
+
+// Fixed-base tables for the public keys seen most recently modulo one p,
+// so a key that verifies many signatures pays for its table once. Beyond
+// `capacity` keys the least recently used table is dropped.
+class PublicKeyTables {
+public:
+    explicit PublicKeyTables(size_t capacity = 16, int width = 4)
+        : capacity(std::max<size_t>(capacity, 1)), width(width) {}
+    
+    // y's table for exponents of up to `bits` bits, built on a miss
+    const modexp::FixedBase& get(const modexp::Modulus& pMod, const BigInt& y, size_t bits) {
+        auto it = index.find(y);
+        if (it != index.end()) {
+            hits++;
+            order.splice(order.begin(), order, it->second);
+            return it->second->second;
+        }
+        misses++;
+        order.emplace_front(y, modexp::FixedBase(pMod, y, bits, width));
+        index[y] = order.begin();
+        if (order.size() > capacity) {
+            index.erase(order.back().first);
+            order.pop_back();
+        }
+        return order.front().second;
+    }
+    
+    void clear() {
+        order.clear();
+        index.clear();
+    }
+    
+    size_t hitCount() const { return hits; }
+    size_t missCount() const { return misses; }
+
+private:
+    size_t capacity;
+    int width;
+    std::list<std::pair<BigInt, modexp::FixedBase>> order;  // Most recent first
+    std::map<BigInt, std::list<std::pair<BigInt, modexp::FixedBase>>::iterator> index;
+    size_t hits = 0, misses = 0;
+};
+
 class DSA {
 private:
-    long long p;  // Prime modulus
-    long long q;  // Prime divisor of p-1
-    long long g;  // Generator
-    long long x;  // Private key
-    long long y;  // Public key
+    BigInt p;  // Prime modulus
+    BigInt q;  // Prime divisor of p-1
+    BigInt g;  // Generator
+    BigInt x;  // Private key
+    BigInt y;  // Public key
+    modexp::Modulus pMod;  // Reduction context for p, built once
+    modexp::FixedBase gTable;  // Powers of g for g^x and g^k, built once per g
+    int tableWidth;  // Window of gTable: bigger is faster, and twice the size per bit
+    PublicKeyTables yTables;  // Tables for y when verifying repeatedly
+    bool standard = false;  // p, q, g loaded from a parameter file
+    bool haveKeys = false;  // x and y generated for the current p, q, g
+    primes::SystemRandom rng;  // Source for x and k
     
     // Generate a prime number
-    long long generatePrime(long long min, long long max) {
-        srand(time(0));
-        for (int attempts = 0; attempts < 1000; attempts++) {
-            long long candidate = min + rand() % (max - min);
-            if (isPrime(candidate)) {
-                return candidate;
-            }
-        }
-        return 0;
+    BigInt generatePrime(long long min, long long max) {
+        // The first prime after a random point, wrapping to min past the end
+        BigInt candidate = primes::nextPrime(BigInt(min) + BigInt::fromU64(rng()) % (max - min), rng);
+        return candidate < max ? candidate : primes::nextPrime(BigInt(min), rng);
     }
     
-    // Find a generator g
-    long long findGenerator() {
-        for (long long h = 2; h < p; h++) {
-            g = modPow(h, (p - 1) / q, p);
-            if (g > 1) {
-                return g;
-            }
-        }
-        return 2;
+    // Uniform in [low, q - 1]
+    BigInt randomBelowQ(long long low) {
+        return BigInt::random(q.bitLength() + 64, rng) % (q - low) + low;
+    }
+    
+    // Exponents mod g's order q have at most as many bits as q
+    void buildTable() {
+        gTable = modexp::FixedBase(pMod, g, q.bitLength(), tableWidth);
     }
 
 public:
-    DSA() : p(0), q(0), g(0), x(0), y(0) {}
+    explicit DSA(int width = modexp::FIXED_WIDTH) : p(0), q(0), g(0), x(0), y(0), tableWidth(width) {}
+    
+    // Keep p, q and g for every later key instead of generating toy ones
+    void useParameters(const DomainParameters& dp) {
+        p = dp.p;
+        q = dp.q;
+        g = dp.g;
+        pMod = modexp::Modulus(p);
+        buildTable();
+        yTables.clear();
+        standard = true;
+        haveKeys = false;
+    }
+    
+    // A fresh private key x and y = g^x mod p, silently
+    void generateKeyPair() {
+        x = randomBelowQ(1);
+        y = gTable.pow(x);
+        haveKeys = true;
+    }
+    
+    // r = (g^k mod p) mod q and s = k^-1 (h + x r) mod q for hash h and
+    // nonce k; fixedBase = false takes g^k by the plain sliding window
+    std::pair<BigInt, BigInt> signHash(const BigInt& h, const BigInt& k, bool fixedBase = true) const {
+        BigInt r = (fixedBase ? gTable.pow(k) : pMod.pow(g, k)) % q;
+        BigInt s = (modInverse(k, q) * (h + x * r)) % q;
+        return {r, s};
+    }
+    
+    // v = (g^u1 y^u2 mod p) mod q for public key pub, as one joint
+    // exponentiation: g's windows ride in pub's squaring chain, or with a
+    // cache, pub's own table (built on first sight) removes the squarings
+    BigInt verifyValue(const BigInt& u1, const BigInt& u2, const BigInt& pub, PublicKeyTables* cache = nullptr) const {
+        if (cache) return gTable.powTimes(u1, cache->get(pMod, pub, q.bitLength()), u2) % q;
+        return gTable.powTimes(u1, pub, u2) % q;
+    }
+    
+    // Whether (r, s) signs hash h under public key pub, silently
+    bool verifyHash(const BigInt& h, const BigInt& r, const BigInt& s, const BigInt& pub,
+                    PublicKeyTables* cache = nullptr) const {
+        if (r <= 0 || r >= q || s <= 0 || s >= q) return false;
+        BigInt w = modInverse(s, q);
+        return verifyValue((h * w) % q, (r * w) % q, pub, cache) == r;
+    }
+    
+    const BigInt& publicKey() const { return y; }
     
     // Generate DSA parameters and keys
     void generateKeys() {
-        std::cout << "Generating DSA parameters and keys..." << std::endl;
-        
-        // Generate prime q (smaller prime)
-        q = generatePrime(1000, 5000);
-        std::cout << "q (prime divisor): " << q << std::endl;
-        
-        // Generate prime p such that q divides (p-1)
-        for (int i = 2; i < 100; i++) {
-            long long candidate = i * q + 1;
-            if (isPrime(candidate)) {
-                p = candidate;
-                break;
+        if (standard) {
+            std::cout << "Generating DSA keys with the " << p.bitLength() << "/" << q.bitLength()
+                      << "-bit parameters..." << std::endl;
+        } else {
+            std::cout << "Generating DSA parameters and keys..." << std::endl;
+            
+            // Generate prime q (smaller prime)
+            q = generatePrime(1000, 5000);
+            std::cout << "q (prime divisor): " << q << std::endl;
+            
+            // Generate prime p such that q divides (p-1)
+            for (int i = 2; i < 100; i++) {
+                BigInt candidate = i * q + 1;
+                if (isPrime(candidate)) {
+                    p = candidate;
+                    break;
+                }
             }
+            std::cout << "p (prime modulus): " << p << std::endl;
+            pMod = modexp::Modulus(p);
+            
+            // Find generator g
+            g = subgroupGenerator(pMod, p, q);
+            std::cout << "g (generator): " << g << std::endl;
+            buildTable();
+            yTables.clear();
         }
-        std::cout << "p (prime modulus): " << p << std::endl;
-        
-        // Find generator g
-        g = findGenerator();
-        std::cout << "g (generator): " << g << std::endl;
         
-        // Generate private key x (random number < q)
-        srand(time(0) + 1);
-        x = (rand() % (q - 1)) + 1;
+        // Private key x (random number < q), public key y = g^x mod p
+        generateKeyPair();
         std::cout << "x (private key): " << x << std::endl;
-        
-        // Calculate public key y = g^x mod p
-        y = modPow(g, x, p);
         std::cout << "y (public key): " << y << std::endl;
         
         std::cout << "\nKeys generated successfully!\n" << std::endl;
     }
     
     // Sign a message
-    std::pair<long long, long long> sign(const std::string& message) {
-        if (p == 0 || q == 0) {
+    std::pair<BigInt, BigInt> sign(const std::string& message) {
+        // Loaded parameters set p and q before any key exists
+        if (!haveKeys) {
             std::cout << "Error: Keys not generated yet!" << std::endl;
             return {0, 0};
         }
         
         // Hash the message
-        long long h = simpleHash(message);
+        BigInt h = simpleHash(message);
         std::cout << "Message hash: " << h << std::endl;
         
         // Generate random k (1 < k < q)
-        srand(time(0) + rand());
-        long long k = (rand() % (q - 2)) + 2;
+        BigInt k = randomBelowQ(2);
         std::cout << "Random k: " << k << std::endl;
         
-        // Calculate r = (g^k mod p) mod q
-        long long r = modPow(g, k, p) % q;
-        
-        // Calculate s = (k^-1 * (h + x*r)) mod q
-        long long k_inv = modInverse(k, q);
-        long long s = (k_inv * (h + x * r)) % q;
+        // r = (g^k mod p) mod q, s = (k^-1 * (h + x*r)) mod q
+        std::pair<BigInt, BigInt> signature = signHash(h, k);
+        BigInt r = signature.first, s = signature.second;
         
         // Make sure r and s are not zero
         if (r == 0 || s == 0) {
@@ -206,8 +402,8 @@ public:
     }
     
     // Verify a signature
-    bool verify(const std::string& message, long long r, long long s) {
-        if (p == 0 || q == 0) {
+    bool verify(const std::string& message, const BigInt& r, const BigInt& s) {
+        if (!haveKeys) {
             std::cout << "Error: Keys not generated yet!" << std::endl;
             return false;
         }
@@ -219,25 +415,23 @@ public:
         }
         
         // Hash the message
-        long long h = simpleHash(message);
+        BigInt h = simpleHash(message);
         std::cout << "Message hash: " << h << std::endl;
         
         // Calculate w = s^-1 mod q
-        long long w = modInverse(s, q);
+        BigInt w = modInverse(s, q);
         std::cout << "w = " << w << std::endl;
         
         // Calculate u1 = (h * w) mod q
-        long long u1 = (h * w) % q;
+        BigInt u1 = (h * w) % q;
         std::cout << "u1 = " << u1 << std::endl;
         
         // Calculate u2 = (r * w) mod q
-        long long u2 = (r * w) % q;
+        BigInt u2 = (r * w) % q;
         std::cout << "u2 = " << u2 << std::endl;
         
         // Calculate v = ((g^u1 * y^u2) mod p) mod q
-        long long v1 = modPow(g, u1, p);
-        long long v2 = modPow(y, u2, p);
-        long long v = ((v1 * v2) % p) % q;
+        BigInt v = verifyValue(u1, u2, y, &yTables);
         std::cout << "v = " << v << std::endl;
         
         // Signature is valid if v == r
@@ -253,10 +447,405 @@ public:
     }
 };
 
-int main() {
+double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Nanoseconds per call of op, repeated until about 20 ms have passed
+template <typename Op>
+double nsPerOp(Op op) {
+    size_t reps = 1;
+    while (true) {
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < reps; i++) op();
+        double t = secondsSince(start);
+        if (t > 0.02) return t / reps * 1e9;
+        reps *= 2;
+    }
+}
+
+// modPow with unsigned __int128 products, for moduli below 2^64
+uint64_t modPow128(uint64_t base, uint64_t exp, uint64_t mod) {
+    unsigned __int128 result = 1, b = base % mod;
+    for (; exp > 0; exp >>= 1) {
+        if (exp & 1) result = result * b % mod;
+        b = b * b % mod;
+    }
+    return uint64_t(result % mod);
+}
+
+// Random operands of random sizes and signs: products against plain
+// schoolbook, q b + r == a for division, shifts, string round trips, small
+// values against long long, and modPow with moduli past 2^32
+bool checkBigInt(std::mt19937_64& rng) {
+    for (int trial = 0; trial < 3000; trial++) {
+        size_t an = 1 + rng() % 160, bn = trial % 3 ? an : 1 + rng() % 160;
+        BigInt a = BigInt::random(64 * an - rng() % 64, rng);
+        BigInt b = BigInt::random(64 * bn - rng() % 64, rng);
+        if (rng() & 1) a = -a;
+        if (rng() & 1) b = -b;
+        if (b.isZero()) continue;
+
+        BigInt product = a * b;
+        std::vector<uint64_t> plain(a.limbCount() + b.limbCount() + 1);
+        if (!a.isZero())
+            bigint::mulSchoolbook(plain.data(), a.limbs().data(), a.limbCount(), b.limbs().data(), b.limbCount());
+        if (product.abs() != BigInt::fromLimbs(plain.data(), plain.size())) {
+            std::cout << "Karatsuba product wrong for " << an << " x " << bn << " limbs" << std::endl;
+            return false;
+        }
+
+        BigInt q, r;
+        BigInt::divMod(product + a, b, q, r);
+        if (q * b + r != product + a || BigInt::compareMagnitude(r, b) >= 0 ||
+            (!r.isZero() && r.isNegative() != (product + a).isNegative()) || (product / b) != a) {
+            std::cout << "Division wrong for " << an + bn << " / " << bn << " limbs" << std::endl;
+            return false;
+        }
+
+        size_t shift = rng() % 300;
+        BigInt parsed, parsedHex;
+        if (((a << shift) >> shift) != a || !BigInt::parse(a.toString(), parsed) || parsed != a ||
+            !BigInt::parse(a.toHex(), parsedHex) || parsedHex != a) {
+            std::cout << "Shift or string round trip wrong for " << a.toHex() << std::endl;
+            return false;
+        }
+    }
+
+    for (int trial = 0; trial < 20000; trial++) {
+        long long x = (long long)(rng() >> (33 + rng() % 31)) * ((rng() & 1) ? -1 : 1);
+        long long y = (long long)(rng() >> (33 + rng() % 31)) * ((rng() & 1) ? -1 : 1);
+        if (y == 0) continue;
+        BigInt bx = x, by = y;
+        if (bx + by != BigInt(x + y) || bx - by != BigInt(x - y) || bx * by != BigInt(x * y) ||
+            bx / by != BigInt(x / y) || bx % by != BigInt(x % y) || (bx < by) != (x < y) ||
+            bx.toString() != std::to_string(x)) {
+            std::cout << "Small value arithmetic wrong for " << x << ", " << y << std::endl;
+            return false;
+        }
+    }
+
+    for (int trial = 0; trial < 200; trial++) {
+        uint64_t m = (rng() >> 1) | 1, b = rng(), e = rng();
+        if (modPow(BigInt::fromU64(b), BigInt::fromU64(e), BigInt::fromU64(m)) != BigInt::fromU64(modPow128(b, e, m))) {
+            std::cout << "modPow wrong for modulus " << m << std::endl;
+            return false;
+        }
+    }
+    std::cout << "BigInt checks pass (Karatsuba, division, shifts, strings, modPow past 2^63)" << std::endl;
+    return true;
+}
+
+// Square-and-multiply with a BigInt % after every step, as modPow did
+// before the shared engine
+BigInt modPowPlain(const BigInt& base, const BigInt& exp, const BigInt& mod) {
+    BigInt result = 1;
+    BigInt b = ::mod(base, mod);
+    for (size_t i = 0; i < exp.bitLength(); i++) {
+        if (exp.testBit(i)) result = (result * b) % mod;
+        b = (b * b) % mod;
+    }
+    return result % mod;
+}
+
+// Both reductions at every window size against modPowPlain, for odd and
+// even moduli from one limb up, then the single-word contexts against
+// __int128 arithmetic
+bool checkModExp(std::mt19937_64& rng) {
+    for (int trial = 0; trial < 400; trial++) {
+        size_t limbs = 1 + rng() % 40;
+        BigInt m = BigInt::random(64 * limbs - rng() % 63, rng) + 2;
+        if (trial % 3 == 0 && m.isOdd()) m += 1;
+        BigInt base = BigInt::random(64 * limbs + 10, rng), exp = BigInt::random(rng() % 300, rng);
+        if (trial % 7 == 0) base = -base;
+        BigInt expected = modPowPlain(base, exp, m);
+        for (int r = modexp::Montgomery; r <= modexp::Barrett; r++) {
+            modexp::Modulus ctx(m, modexp::Reduction(r));
+            for (int window = 0; window <= 6; window++) {
+                if (ctx.pow(base, exp, window) != expected) {
+                    std::cout << "Modular exponentiation wrong (" << modexp::reductionName(ctx.reduction())
+                              << ", window " << window << ", " << m.bitLength() << "-bit modulus)" << std::endl;
+                    return false;
+                }
+            }
+        }
+    }
+    // m = B^(n-1) exactly, where Barrett's mu needs an extra limb
+    for (size_t limbs = 1; limbs <= 8; limbs++) {
+        BigInt m = BigInt(1) << (64 * limbs), base = BigInt::random(64 * limbs, rng), exp = BigInt::random(200, rng);
+        if (modexp::powMod(base, exp, m, modexp::Barrett) != modPowPlain(base, exp, m)) {
+            std::cout << "Modular exponentiation wrong for modulus 2^" << 64 * limbs << std::endl;
+            return false;
+        }
+    }
+    // Past MAX_LIMBS every reduction falls back to division
+    for (size_t limbs = modexp::MAX_LIMBS; limbs <= modexp::MAX_LIMBS + 2; limbs++) {
+        BigInt m = BigInt::random(64 * limbs, rng) + (BigInt(1) << (64 * limbs - 1));
+        BigInt base = BigInt::random(64 * limbs + 10, rng), exp = BigInt::random(40, rng);
+        for (int r = modexp::Montgomery; r <= modexp::Division; r++) {
+            if (modexp::powMod(base, exp, m, modexp::Reduction(r)) != modPowPlain(base, exp, m) ||
+                modexp::FixedBase(modexp::Modulus(m), base, 40, 3).pow(exp) != modPowPlain(base, exp, m)) {
+                std::cout << "Modular exponentiation wrong for a " << m.bitLength() << "-bit modulus" << std::endl;
+                return false;
+            }
+        }
+    }
+    for (int trial = 0; trial < 20000; trial++) {
+        uint64_t m = rng() >> (rng() % 63), b = rng(), e = rng() >> (rng() % 64);
+        if (m == 0) continue;
+        if (modexp::powMod(b, e, m, modexp::Montgomery) != modPow128(b, e, m) ||
+            modexp::powMod(b, e, m, modexp::Barrett) != modPow128(b, e, m)) {
+            std::cout << "64-bit modular exponentiation wrong for modulus " << m << std::endl;
+            return false;
+        }
+    }
+    std::cout << "Modular exponentiation checks pass (Montgomery, Barrett, division, windows 1-6)" << std::endl;
+    return true;
+}
+
+// Exponentiations per second with a full-size exponent: hardware % or
+// BigInt %, then each reduction with plain binary and sliding windows
+void runModExpBenchmark(std::mt19937_64& rng) {
+    volatile uint64_t sink = 0;
+    std::cout << "\nModular exponentiations/s (exponent as long as the modulus)" << std::endl;
+    std::cout << "   bits     plain %  barrett  barrett/w  montgomery  montgomery/w" << std::endl;
+    for (size_t bits : {64, 1024, 2048, 3072}) {
+        BigInt m = BigInt::random(bits - 1, rng) + (BigInt(1) << (bits - 1));
+        if (!m.isOdd()) m += 1;
+        BigInt base = BigInt::random(bits - 1, rng), exp = BigInt::random(bits, rng);
+        modexp::Modulus barrett(m, modexp::Barrett), montgomery(m, modexp::Montgomery);
+
+        double plain;
+        if (bits == 64) {
+            uint64_t m64 = m.low64(), b64 = base.low64(), e64 = exp.low64();
+            plain = nsPerOp([&] { sink = sink + modPow128(b64, e64, m64); });
+        } else {
+            plain = nsPerOp([&] { sink = sink + modPowPlain(base, exp, m).low64(); });
+        }
+        std::cout << std::setw(7) << bits << std::fixed << std::setprecision(0) << std::setw(12) << 1e9 / plain;
+        for (const modexp::Modulus* ctx : {&barrett, &montgomery}) {
+            std::cout << std::setw(ctx == &barrett ? 9 : 12)
+                      << 1e9 / nsPerOp([&] { sink = sink + ctx->pow(base, exp, 1).low64(); });
+            std::cout << std::setw(ctx == &barrett ? 11 : 14)
+                      << 1e9 / nsPerOp([&] { sink = sink + ctx->pow(base, exp).low64(); });
+        }
+        std::cout << std::defaultfloat << std::setprecision(6) << std::endl;
+    }
+}
+
+// A 1024/160 parameter set through the file and back, and the load time
+bool checkParameterFile() {
+    const std::string path = "exp10_bench.params";
+    DomainParameters dp = generateParameters(1024, 160), loaded;
+    bool ok = checkParameters(dp) && saveParameters(path, dp) && loadParameters(path, loaded) &&
+              loaded.p == dp.p && loaded.q == dp.q && loaded.g == dp.g;
+    double ns = ok ? nsPerOp([&] { loadParameters(path, loaded); }) : 0;
+    std::remove(path.c_str());
+    if (!ok) {
+        std::cout << "Parameter file round trip failed" << std::endl;
+        return false;
+    }
+    std::cout << "Parameter file round trip OK; 1024/160 load + check " << std::fixed << std::setprecision(1)
+              << ns / 1e3 << " us" << std::defaultfloat << std::setprecision(6) << std::endl;
+    return true;
+}
+
+// Signatures/s with g^k by the plain sliding window and by fixed-base
+// tables of several widths. Both paths must give the same signature for
+// the same nonce.
+bool runSigningBenchmark(const std::vector<DomainParameters>& sets, std::mt19937_64& rng) {
+    volatile uint64_t sink = 0;
+    std::cout << "\nDSA signing, signatures/s (g^k by sliding window vs fixed-base table)" << std::endl;
+    std::cout << "      L/N   width   table KiB   build ms    signs/s   speedup" << std::endl;
+    for (const DomainParameters& dp : sets) {
+        size_t L = dp.L;
+        BigInt h = BigInt::random(256, rng);
+        std::vector<BigInt> nonces;
+        for (int i = 0; i < 64; i++) nonces.push_back(BigInt::random(256 + 64, rng) % (dp.q - 2) + 2);
+        size_t next = 0;
+        auto nonce = [&]() -> const BigInt& { return nonces[next++ % nonces.size()]; };
+
+        DSA plain;
+        plain.useParameters(dp);
+        plain.generateKeyPair();
+        double base = 1e9 / nsPerOp([&] { sink = sink + plain.signHash(h, nonce(), false).first.low64(); });
+        std::cout << std::setw(6) << L << "/" << dp.N << "   plain" << std::setw(12) << "-" << std::setw(11) << "-" << std::fixed
+                  << std::setprecision(0) << std::setw(11) << base << std::defaultfloat << std::setprecision(6) << std::endl;
+
+        for (int width : {2, 4, 6, 8}) {
+            auto start = std::chrono::steady_clock::now();
+            modexp::FixedBase table(modexp::Modulus(dp.p), dp.g, dp.N, width);
+            double build = secondsSince(start) * 1e3;
+            DSA dsa(width);
+            dsa.useParameters(dp);
+            dsa.generateKeyPair();
+            for (const BigInt& k : nonces) {
+                if (dsa.signHash(h, k) != dsa.signHash(h, k, false) || table.pow(k) != modPow(dp.g, k, dp.p)) {
+                    std::cout << "Fixed-base signature differs at width " << width << std::endl;
+                    return false;
+                }
+            }
+            double rate = 1e9 / nsPerOp([&] { sink = sink + dsa.signHash(h, nonce()).first.low64(); });
+            std::cout << std::setw(14) << width << std::fixed << std::setprecision(0) << std::setw(12)
+                      << table.bytes() / 1024.0 << std::setprecision(1) << std::setw(11) << build << std::setprecision(0)
+                      << std::setw(11) << rate << std::setprecision(2) << std::setw(9) << rate / base << "x"
+                      << std::defaultfloat << std::setprecision(6) << std::endl;
+        }
+    }
+    return true;
+}
+
+// Verifications/s for 64 signatures under 8 keys: g^u1 and y^u2 apart (as
+// verify() used to), jointly by power2, jointly with g's windows from its
+// table, and with each y's own table from the cache. Every path must accept
+// every signature and reject it with s changed.
+bool runVerifyBenchmark(const std::vector<DomainParameters>& sets, std::mt19937_64& rng) {
+    struct Signed {
+        BigInt h, r, s, y;
+    };
+    volatile uint64_t sink = 0;
+    std::cout << "\nDSA verification, verifications/s (64 signatures, 8 public keys)" << std::endl;
+    std::cout << "      L/N   separate    power2   g table   g + y tables   speedup" << std::endl;
+    for (const DomainParameters& dp : sets) {
+        DSA dsa;
+        dsa.useParameters(dp);
+        std::vector<Signed> items;
+        for (int key = 0; key < 8; key++) {
+            dsa.generateKeyPair();
+            for (int i = 0; i < 8; i++) {
+                BigInt h = BigInt::random(256, rng), k = BigInt::random(256 + 64, rng) % (dp.q - 2) + 2;
+                std::pair<BigInt, BigInt> rs = dsa.signHash(h, k);
+                items.push_back({h, rs.first, rs.second, dsa.publicKey()});
+            }
+        }
+
+        modexp::Modulus pMod(dp.p);
+        modexp::FixedBase gTable(pMod, dp.g, dp.N);
+        PublicKeyTables cache;
+        typedef std::function<BigInt(const BigInt&, const BigInt&, const BigInt&)> Joint;
+        std::vector<Joint> paths = {
+            [&](const BigInt& u1, const BigInt& u2, const BigInt& y) { return pMod.pow(dp.g, u1) * pMod.pow(y, u2) % dp.p; },
+            [&](const BigInt& u1, const BigInt& u2, const BigInt& y) { return pMod.pow2(dp.g, u1, y, u2); },
+            [&](const BigInt& u1, const BigInt& u2, const BigInt& y) { return gTable.powTimes(u1, y, u2); },
+            [&](const BigInt& u1, const BigInt& u2, const BigInt& y) { return gTable.powTimes(u1, cache.get(pMod, y, dp.N), u2); },
+        };
+        auto verifies = [&](const Joint& joint, const Signed& item, const BigInt& s) {
+            BigInt w = modInverse(s, dp.q);
+            return joint((item.h * w) % dp.q, (item.r * w) % dp.q, item.y) % dp.q == item.r;
+        };
+        for (const Signed& item : items) {
+            bool ok = dsa.verifyHash(item.h, item.r, item.s, item.y) && !dsa.verifyHash(item.h, item.r, item.s + 1, item.y);
+            for (const Joint& joint : paths) ok = ok && verifies(joint, item, item.s) && !verifies(joint, item, item.s + 1);
+            if (!ok) {
+                std::cout << "Verification paths disagree at " << dp.L << "/" << dp.N << std::endl;
+                return false;
+            }
+        }
+
+        std::cout << std::setw(6) << dp.L << "/" << dp.N << std::fixed << std::setprecision(0);
+        size_t next = 0;
+        double base = 0, rate = 0;
+        for (size_t i = 0; i < paths.size(); i++) {
+            rate = 1e9 / nsPerOp([&] {
+                const Signed& item = items[next++ % items.size()];
+                sink = sink + verifies(paths[i], item, item.s);
+            });
+            if (i == 0) base = rate;
+            std::cout << std::setw(i == 3 ? 15 : 10) << rate;
+        }
+        std::cout << std::setprecision(2) << std::setw(9) << rate / base << "x" << std::defaultfloat
+                  << std::setprecision(6) << std::endl;
+    }
+    return true;
+}
+
+int runBenchmark() {
+    std::mt19937_64 rng(12345);
+    if (!checkBigInt(rng) || !checkModExp(rng) || !checkParameterFile()) return 1;
+    volatile uint64_t sink = 0;
+
+    // Where Karatsuba starts to pay: plain schoolbook against a single
+    // Karatsuba level on top of it
+    std::cout << "\nn x n limb products, ns (schoolbook vs one Karatsuba level)" << std::endl;
+    for (size_t n : {8, 12, 16, 24, 32, 48, 64, 96}) {
+        std::vector<uint64_t> a(n), b(n), r(2 * n), scratch(bigint::karatsubaScratch(n));
+        for (size_t i = 0; i < n; i++) a[i] = rng(), b[i] = rng();
+        double school = nsPerOp([&] { bigint::mulSchoolbook(r.data(), a.data(), n, b.data(), n); sink = sink + r[n]; });
+        double kara = nsPerOp([&] { bigint::mulKaratsuba(r.data(), a.data(), b.data(), n, scratch.data(), n); sink = sink + r[n]; });
+        std::cout << "  " << std::setw(3) << n << " limbs: " << std::setw(8) << school << "  " << std::setw(8) << kara
+                  << (n >= bigint::KARATSUBA_THRESHOLD ? "   (Karatsuba used)" : "") << std::endl;
+    }
+
+    std::cout << "\nBigInt operations, ns per call" << std::endl;
+    std::cout << "   bits      add      sub      mul   square   divmod    shift  compare  toString" << std::endl;
+    for (size_t bits : {256, 512, 1024, 2048, 4096}) {
+        BigInt a = BigInt::random(bits, rng), b = BigInt::random(bits, rng);
+        BigInt wide = a * b + a, q, r;
+        std::cout << std::setw(7) << bits << std::fixed << std::setprecision(0);
+        std::cout << std::setw(9) << nsPerOp([&] { sink = sink + (a + b).low64(); });
+        std::cout << std::setw(9) << nsPerOp([&] { sink = sink + (a - b).low64(); });
+        std::cout << std::setw(9) << nsPerOp([&] { sink = sink + (a * b).low64(); });
+        std::cout << std::setw(9) << nsPerOp([&] { sink = sink + (a * a).low64(); });
+        std::cout << std::setw(9) << nsPerOp([&] { BigInt::divMod(wide, b, q, r); sink = sink + r.low64(); });
+        std::cout << std::setw(9) << nsPerOp([&] { sink = sink + ((a << 61) >> 3).low64(); });
+        std::cout << std::setw(9) << nsPerOp([&] { sink = sink + (a < b); });
+        std::cout << std::setw(10) << nsPerOp([&] { sink = sink + a.toString().size(); });
+        std::cout << std::defaultfloat << std::setprecision(6) << std::endl;
+    }
+    runModExpBenchmark(rng);
+    std::vector<DomainParameters> sets = {generateParameters(2048, 256), generateParameters(3072, 256)};
+    return runSigningBenchmark(sets, rng) && runVerifyBenchmark(sets, rng) ? 0 : 1;
+}
+
+// exp10 --params L N [PARAMFILE]: the one slow step, run on request
+int runParameterGeneration(size_t L, size_t N, const std::string& path) {
+    if (!standardSizes(L, N)) {
+        std::cerr << "exp10: (L, N) must be (1024, 160), (2048, 224), (2048, 256) or (3072, 256)" << std::endl;
+        return 1;
+    }
+    auto start = std::chrono::steady_clock::now();
+    DomainParameters dp = generateParameters(L, N);
+    double t = secondsSince(start);
+    if (!checkParameters(dp) || !saveParameters(path, dp)) {
+        std::cerr << "exp10: " << path << ": could not write parameters" << std::endl;
+        return 1;
+    }
+    std::cout << std::hex << "p = " << dp.p << "\nq = " << dp.q << "\ng = " << dp.g << std::dec << std::endl;
+    std::cout << L << "/" << N << "-bit parameters generated in " << t << " s, saved to " << path << " ("
+              << paramsFileSize(L, N) << " bytes)" << std::endl;
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    std::string mode = argc > 1 ? argv[1] : "";
+    if (mode == "--bench") return runBenchmark();
+    if (mode == "--params" && (argc == 4 || argc == 5))
+        return runParameterGeneration(std::strtoul(argv[2], nullptr, 10), std::strtoul(argv[3], nullptr, 10),
+                                      argc == 5 ? argv[4] : DEFAULT_PARAMS_FILE);
+    if (argc > 2 || (!mode.empty() && mode[0] == '-')) {
+        std::cerr << "Usage: " << argv[0] << " [PARAMFILE | --params L N [PARAMFILE] | --bench]" << std::endl;
+        return 1;
+    }
+
     DSA dsa;
+    std::string paramsPath = argc > 1 ? mode : DEFAULT_PARAMS_FILE;
+    DomainParameters dp;
+    auto start = std::chrono::steady_clock::now();
+    if (loadParameters(paramsPath, dp)) {
+        dsa.useParameters(dp);
+        std::cout << "Loaded " << dp.L << "/" << dp.N << "-bit DSA parameters from " << paramsPath << " in "
+                  << secondsSince(start) * 1e3 << " ms" << std::endl;
+    } else if (argc > 1) {
+        std::cerr << "exp10: " << paramsPath << ": not a valid parameter file" << std::endl;
+        return 1;
+    } else if (access(paramsPath.c_str(), F_OK) == 0) {
+        // The default file is optional, but one that is there and broken
+        // should not be skipped without a word
+        std::cerr << "exp10: warning: " << paramsPath << ": not a valid parameter file, using toy parameters"
+                  << std::endl;
+    }
     std::string message;
-    long long r = 0, s = 0;
+    BigInt r = 0, s = 0;
     
     while (true) {
         std::cout << "\n=== Digital Signature Algorithm (DSA) ===" << std::endl;
@@ -3,12 +3,32 @@
 // works exactly the same for all monoalphabetic ciphers.
 // Encryption/Decryption: Every letter in the alphabet is represented by
 // exactly one other letter in the key.
+//
+//   ./exp2 --bench [MiB]    compare the map, table and pshufb paths (default 1 GiB)
+//                           and the parallel driver from 1 to N threads
 
 #include <iostream>
 #include <string>
 #include <unordered_map>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include "parallel_chunks.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MONO_X86 1
+#endif
 using namespace std;
 
+// Flat translation table: every byte value maps straight to its output byte.
+// lower[] holds the 26 substitutes of 'a'..'z' again for the pshufb path,
+// which only works when all of them are lower case letters (shuffleOk).
+struct SubstitutionTable {
+    unsigned char t[256];
+    unsigned char lower[32];
+    bool shuffleOk;
+};
+
 // Function to build mapping from standard to key alphabet
 unordered_map<char, char> buildMap(const string& from, const string& to) {
     unordered_map<char, char> map;
@@ -18,8 +38,115 @@ unordered_map<char, char> buildMap(const string& from, const string& to) {
     return map;
 }
 
-// Function to encrypt or decrypt text
+// Fill in the upper case entries and the pshufb copy once t[] holds the
+// lower case mapping
+void finishTable(SubstitutionTable& table) {
+    table.shuffleOk = true;
+    memset(table.lower, 0, sizeof(table.lower));
+    for (char c = 'a'; c <= 'z'; ++c) {
+        unsigned char sub = table.t[(unsigned char)c];
+        table.t[toupper(c)] = toupper(sub);
+        table.lower[c - 'a'] = sub;
+        if (sub < 'a' || sub > 'z') table.shuffleOk = false;
+    }
+}
+
+// Build the translation table from a lower case mapping (throws
+// out_of_range if a letter is missing, like map.at() in the old loop)
+SubstitutionTable buildTable(const unordered_map<char, char>& map) {
+    SubstitutionTable table;
+    for (int i = 0; i < 256; ++i) table.t[i] = (unsigned char)i;
+    for (char c = 'a'; c <= 'z'; ++c) table.t[(unsigned char)c] = map.at(c);
+    finishTable(table);
+    return table;
+}
+
+SubstitutionTable buildTable(const string& from, const string& to) {
+    SubstitutionTable table;
+    for (int i = 0; i < 256; ++i) table.t[i] = (unsigned char)i;
+    for (int i = 0; i < 26; ++i) table.t[(unsigned char)from[i]] = to[i];
+    finishTable(table);
+    return table;
+}
+
+// One table load per byte, no branches
+void translateScalar(const SubstitutionTable& table, const char* in, char* out, size_t len) {
+    for (size_t i = 0; i < len; ++i) out[i] = table.t[(unsigned char)in[i]];
+}
+
+#ifdef MONO_X86
+// Letters become an index 0..25; two 16-entry pshufb lookups cover the
+// alphabet and the original case bit is put back afterwards.
+__attribute__((target("ssse3")))
+void translateSSSE3(const SubstitutionTable& table, const char* in, char* out, size_t len) {
+    const __m128i lo = _mm_loadu_si128((const __m128i*)table.lower);
+    const __m128i hi = _mm_loadu_si128((const __m128i*)(table.lower + 16));
+    const __m128i caseBit = _mm_set1_epi8(0x20), n16 = _mm_set1_epi8(16);
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i c = _mm_loadu_si128((const __m128i*)(in + i));
+        __m128i t = _mm_sub_epi8(_mm_or_si128(c, caseBit), _mm_set1_epi8('a'));
+        __m128i isLetter = _mm_cmpeq_epi8(_mm_min_epu8(t, _mm_set1_epi8(25)), t);
+        __m128i isHigh = _mm_cmpeq_epi8(_mm_max_epu8(t, n16), t);
+        __m128i sub = _mm_or_si128(_mm_andnot_si128(isHigh, _mm_shuffle_epi8(lo, t)),
+                                   _mm_and_si128(isHigh, _mm_shuffle_epi8(hi, _mm_sub_epi8(t, n16))));
+        sub = _mm_or_si128(_mm_andnot_si128(caseBit, sub), _mm_and_si128(c, caseBit));
+        _mm_storeu_si128((__m128i*)(out + i),
+                         _mm_or_si128(_mm_and_si128(isLetter, sub), _mm_andnot_si128(isLetter, c)));
+    }
+    translateScalar(table, in + i, out + i, len - i);
+}
+
+__attribute__((target("avx2")))
+void translateAVX2(const SubstitutionTable& table, const char* in, char* out, size_t len) {
+    const __m256i lo = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)table.lower));
+    const __m256i hi = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)(table.lower + 16)));
+    const __m256i caseBit = _mm256_set1_epi8(0x20), n16 = _mm256_set1_epi8(16);
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i c = _mm256_loadu_si256((const __m256i*)(in + i));
+        __m256i t = _mm256_sub_epi8(_mm256_or_si256(c, caseBit), _mm256_set1_epi8('a'));
+        __m256i isLetter = _mm256_cmpeq_epi8(_mm256_min_epu8(t, _mm256_set1_epi8(25)), t);
+        __m256i isHigh = _mm256_cmpeq_epi8(_mm256_max_epu8(t, n16), t);
+        __m256i sub = _mm256_blendv_epi8(_mm256_shuffle_epi8(lo, t),
+                                         _mm256_shuffle_epi8(hi, _mm256_sub_epi8(t, n16)), isHigh);
+        sub = _mm256_or_si256(_mm256_andnot_si256(caseBit, sub), _mm256_and_si256(c, caseBit));
+        _mm256_storeu_si256((__m256i*)(out + i), _mm256_blendv_epi8(c, sub, isLetter));
+    }
+    translateSSSE3(table, in + i, out + i, len - i);
+}
+#endif
+
+// Translate in[0..len) into out (may be the same buffer), using pshufb
+// when the CPU and the key allow it
+void translate(const SubstitutionTable& table, const char* in, char* out, size_t len) {
+#ifdef MONO_X86
+    static const bool hasAVX2 = __builtin_cpu_supports("avx2");
+    static const bool hasSSSE3 = __builtin_cpu_supports("ssse3");
+    if (table.shuffleOk && hasAVX2) return translateAVX2(table, in, out, len);
+    if (table.shuffleOk && hasSSSE3) return translateSSSE3(table, in, out, len);
+#endif
+    translateScalar(table, in, out, len);
+}
+
+// Function to encrypt or decrypt text (large inputs are translated in
+// parallel chunks on the pool)
+string monoalphabeticCipher(const string& text, const SubstitutionTable& table,
+                            ChunkPool& pool = ChunkPool::shared()) {
+    string result(text.size(), '\0');
+    pool.run(text.size(), PARALLEL_CHUNK_SIZE, 1, [&](size_t b, size_t e) {
+        translate(table, text.data() + b, &result[b], e - b);
+    });
+    return result;
+}
+
+// Map-based API, now a thin wrapper over the translation table
 string monoalphabeticCipher(const string& text, const unordered_map<char, char>& map) {
+    return monoalphabeticCipher(text, buildTable(map));
+}
+
+// The original hash-lookup-per-byte loop, kept as the benchmark baseline
+string monoalphabeticCipherReference(const string& text, const unordered_map<char, char>& map) {
     string result = "";
     for (char c : text) {
         if (isupper(c)) {
@@ -33,15 +160,93 @@ string monoalphabeticCipher(const string& text, const unordered_map<char, char>&
     return result;
 }
 
-int main() {
+double secondsSince(chrono::steady_clock::time_point start) {
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+// Run fn over a 1 GiB (or mib MiB) corpus by cycling one 16 MiB buffer
+// and return MB/s
+template <typename Fn>
+double corpusThroughput(const string& chunk, size_t mib, Fn fn) {
+    size_t total = mib << 20;
+    auto start = chrono::steady_clock::now();
+    for (size_t done = 0; done < total; done += chunk.size()) fn(chunk);
+    return double(total) / (1 << 20) / secondsSince(start);
+}
+
+int runBenchmark(const string& plainAlphabet, const string& keyAlphabet, size_t mib) {
+    unordered_map<char, char> encryptMap = buildMap(plainAlphabet, keyAlphabet);
+    SubstitutionTable table = buildTable(encryptMap);
+
+    const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz"
+                            "abcdefghijklmnopqrstuvwxyz0123456789 ,.;!?-\n";
+    string chunk(16 << 20, ' ');
+    unsigned int seed = 7;
+    for (char& c : chunk) {
+        seed = seed * 1103515245 + 12345;
+        c = alphabet[(seed >> 16) % (sizeof(alphabet) - 1)];
+    }
+    for (int c = 0; c < 256; ++c) chunk[c] = char(c);
+
+    string expected = monoalphabeticCipherReference(chunk, encryptMap);
+    string out(chunk.size(), '\0');
+    translateScalar(table, chunk.data(), &out[0], chunk.size());
+    bool ok = out == expected;
+#ifdef MONO_X86
+    if (__builtin_cpu_supports("ssse3")) {
+        translateSSSE3(table, chunk.data(), &out[0], chunk.size());
+        ok = ok && out == expected;
+    }
+#endif
+    ok = ok && monoalphabeticCipher(chunk, table) == expected;
+    ok = ok && monoalphabeticCipher(expected, buildTable(keyAlphabet, plainAlphabet)) == chunk;
+    if (!ok) {
+        cout << "Table translation does not match the map-based cipher\n";
+        return 1;
+    }
+
+    volatile char sink = 0;
+    cout << "Monoalphabetic throughput over " << mib << " MiB\n";
+    cout << "  unordered_map  : " << corpusThroughput(chunk, mib, [&](const string& in) {
+        sink = sink + monoalphabeticCipherReference(in, encryptMap)[0];
+    }) << " MB/s\n";
+    cout << "  256-byte table : " << corpusThroughput(chunk, mib, [&](const string& in) {
+        translateScalar(table, in.data(), &out[0], in.size());
+    }) << " MB/s\n";
+    cout << "  dispatched     : " << corpusThroughput(chunk, mib, [&](const string& in) {
+        translate(table, in.data(), &out[0], in.size());
+    }) << " MB/s" << (table.shuffleOk ? "" : " (key not pshufb-friendly, scalar)") << "\n";
+
+    // Scaling of the chunked parallel driver over a 256 MiB string
+    string big;
+    while (big.size() < (256u << 20)) big += chunk;
+    double mb = double(big.size()) / (1 << 20), tOne = 0;
+    cout << "Parallel scaling over " << big.size() / (1 << 20) << " MiB\n";
+    for (unsigned threads : scalingThreadCounts()) {
+        ChunkPool pool(threads);
+        auto start = chrono::steady_clock::now();
+        string enc = monoalphabeticCipher(big, table, pool);
+        double t = secondsSince(start);
+        if (threads == 1) tOne = t;
+        cout << "  " << threads << " thread(s)    : " << mb / t << " MB/s, speedup " << tOne / t << "x\n";
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
     string plainAlphabet = "abcdefghijklmnopqrstuvwxyz";
 
     // Monoalphabetic key (must be a permutation of 26 unique letters)
     string keyAlphabet ="qwertyuiopasdfghjklzxcvbnm"; // key
 
-    // Build encrypt and decrypt maps
-    unordered_map<char, char> encryptMap = buildMap(plainAlphabet, keyAlphabet);
-    unordered_map<char, char> decryptMap = buildMap(keyAlphabet, plainAlphabet);
+    if (argc > 1 && string(argv[1]) == "--bench") {
+        size_t mib = argc > 2 ? strtoul(argv[2], nullptr, 10) : 1024;
+        return runBenchmark(plainAlphabet, keyAlphabet, mib ? mib : 1024);
+    }
+
+    // Build encrypt and decrypt tables once per key
+    SubstitutionTable encryptTable = buildTable(plainAlphabet, keyAlphabet);
+    SubstitutionTable decryptTable = buildTable(keyAlphabet, plainAlphabet);
 
     int choice;
     string input;
@@ -55,9 +260,9 @@ int main() {
     getline(cin, input);
 
     if (choice == 1) {
-        cout << "Encrypted Text: " << monoalphabeticCipher(input, encryptMap) << endl;
+        cout << "Encrypted Text: " << monoalphabeticCipher(input, encryptTable) << endl;
     } else if (choice == 2) {
-        cout << "Decrypted Text: " << monoalphabeticCipher(input, decryptMap) << endl;
+        cout << "Decrypted Text: " << monoalphabeticCipher(input, decryptTable) << endl;
     } else {
         cout << "Invalid choice." << endl;
     }
@@ -16,21 +16,227 @@
 // Same Row → replace each letter with the one to its left.
 // Same Column → replace each letter with the one above.
 // Rectangle → same as encryption (swap columns).
+//
+// The key table is a flat 25-byte array and every one of the 25x25 digraphs
+// is looked up in a precomputed table, one for each direction.
+//   ./exp3 -e|-d <key> [infile [outfile]]   stream a file/stdin of any size
+//   ./exp3 --bench [MiB]                    compare with the original map-based class
 
 #include <iostream>
 #include <vector>
+#include <array>
 #include <string>
 #include <map>
 #include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
 
 using namespace std;
 
+// One-pass Playfair text preparation. Bytes are fed in any number of
+// pieces; upper-casing, J -> I, dropping non-letters and (for encryption)
+// X insertion between doubled letters all happen as they arrive, and each
+// completed digraph is written out straight away. Only the unpaired letter
+// is carried between calls, so no intermediate strings are needed.
+class DigraphPreparer {
+    bool forEncryption;
+    char pending = 0; // first letter of a digraph still waiting for its partner
+
+    // Byte -> upper case letter with J folded into I, or 0 to drop it
+    static const char *foldTable() {
+        static const array<char, 256> table = [] {
+            array<char, 256> t;
+            for (int b = 0; b < 256; b++) {
+                char c = toupper(b);
+                if (c == 'J') c = 'I';
+                t[b] = (c >= 'A' && c <= 'Z') ? c : 0;
+            }
+            return t;
+        }();
+        return table.data();
+    }
+
+public:
+    explicit DigraphPreparer(bool encryption) : forEncryption(encryption) {}
+
+    // Worst case output: two letters per input byte, plus the final pad
+    static size_t maxOutput(size_t len) { return 2 * len + 2; }
+
+    // Feed in[0..len); complete digraphs go to out. Returns letters written.
+    size_t feed(const char *in, size_t len, char *out) {
+        const char *fold = foldTable();
+        size_t n = 0;
+        for (size_t i = 0; i < len; i++) {
+            char c = fold[static_cast<unsigned char>(in[i])];
+            if (!c) continue;
+            if (!pending) {
+                pending = c;
+            } else if (forEncryption && pending == c) {
+                out[n++] = pending; // doubled letter: split with X
+                out[n++] = 'X';
+            } else {
+                out[n++] = pending;
+                out[n++] = c;
+                pending = 0;
+            }
+        }
+        return n;
+    }
+
+    // End of input: pad a leftover letter with X. Returns letters written.
+    size_t finish(char *out) {
+        if (!pending) return 0;
+        out[0] = pending;
+        out[1] = 'X';
+        pending = 0;
+        return 2;
+    }
+};
+
 class PlayfairCipher {
+    char keyTable[25];            // 5x5 key table, row-major
+    unsigned char cell[26];       // letter - 'A' -> row * 5 + col (J shares I's cell)
+    char encPair[625][2];         // (cell a) * 25 + (cell b) -> encrypted digraph
+    char decPair[625][2];         // same for decryption
+
+    // Apply the Playfair rules to the digraph in cells a and b; step is 1
+    // to encrypt and 4 (one step back, mod 5) to decrypt
+    void mapDigraph(int a, int b, int step, char out[2]) const {
+        int r1 = a / 5, c1 = a % 5;
+        int r2 = b / 5, c2 = b % 5;
+
+        if (r1 == r2) { // Same row
+            out[0] = keyTable[r1 * 5 + (c1 + step) % 5];
+            out[1] = keyTable[r2 * 5 + (c2 + step) % 5];
+        } else if (c1 == c2) { // Same column
+            out[0] = keyTable[(r1 + step) % 5 * 5 + c1];
+            out[1] = keyTable[(r2 + step) % 5 * 5 + c2];
+        } else { // Rectangle
+            out[0] = keyTable[r1 * 5 + c2];
+            out[1] = keyTable[r2 * 5 + c1];
+        }
+    }
+
+    // Replace each digraph of text[0..len) (upper case letters, J already
+    // folded into I, even length) through one of the 625-entry tables
+    static void lookupDigraphs(const char (*pairs)[2], const unsigned char *cell,
+                               const char *text, size_t len, char *out) {
+        for (size_t i = 0; i + 1 < len; i += 2) {
+            const char *p = pairs[cell[text[i] - 'A'] * 25 + cell[text[i + 1] - 'A']];
+            out[i] = p[0];
+            out[i + 1] = p[1];
+        }
+    }
+
+public:
+    PlayfairCipher(string key) {
+        createKeyTable(key);
+    }
+
+    void createKeyTable(string key) {
+        vector<bool> used(26, false);
+        string filteredKey;
+
+        // Uppercase, replace J with I, remove duplicates
+        for (char c : key) {
+            c = toupper(static_cast<unsigned char>(c));
+            if (c == 'J') c = 'I';
+            if (c < 'A' || c > 'Z') continue;
+            if (!used[c - 'A']) {
+                used[c - 'A'] = true;
+                filteredKey.push_back(c);
+            }
+        }
+
+        // Add remaining letters
+        for (char c = 'A'; c <= 'Z'; c++) {
+            if (c == 'J') continue;
+            if (!used[c - 'A']) {
+                used[c - 'A'] = true;
+                filteredKey.push_back(c);
+            }
+        }
+
+        // Fill 5x5 table
+        for (int idx = 0; idx < 25; idx++) {
+            keyTable[idx] = filteredKey[idx];
+            cell[filteredKey[idx] - 'A'] = idx;
+        }
+        cell['J' - 'A'] = cell['I' - 'A'];
+
+        // Precompute every digraph once
+        for (int a = 0; a < 25; a++) {
+            for (int b = 0; b < 25; b++) {
+                mapDigraph(a, b, 1, encPair[a * 25 + b]);
+                mapDigraph(a, b, 4, decPair[a * 25 + b]);
+            }
+        }
+    }
+
+    string prepareText(string text, bool forEncryption) {
+        DigraphPreparer prep(forEncryption);
+        string result(DigraphPreparer::maxOutput(text.size()), '\0');
+        size_t n = prep.feed(text.data(), text.size(), &result[0]);
+        n += prep.finish(&result[n]); // odd ciphertext is padded like plaintext
+        result.resize(n);
+        return result;
+    }
+
+    string encrypt(string plaintext) {
+        return transform(plaintext, true);
+    }
+
+    string decrypt(string ciphertext) {
+        return transform(ciphertext, false);
+    }
+
+    // Prepare and look up in one pass over a single output buffer
+    string transform(const string &text, bool forEncryption) {
+        DigraphPreparer prep(forEncryption);
+        string out(DigraphPreparer::maxOutput(text.size()), '\0');
+        size_t n = prep.feed(text.data(), text.size(), &out[0]);
+        n += prep.finish(&out[n]);
+        lookupDigraphs(forEncryption ? encPair : decPair, cell, out.data(), n, &out[0]);
+        out.resize(n);
+        return out;
+    }
+
+    // Streaming mode: read in through a fixed buffer, write digraphs to out
+    // as they complete. Memory use does not depend on the input size.
+    // Returns false on a read or write error.
+    bool transformStream(FILE *in, FILE *out, bool forEncryption, size_t bufSize = 64 << 10) {
+        DigraphPreparer prep(forEncryption);
+        const char (*pairs)[2] = forEncryption ? encPair : decPair;
+        vector<char> inBuf(bufSize), outBuf(DigraphPreparer::maxOutput(bufSize));
+
+        size_t len;
+        while ((len = fread(inBuf.data(), 1, inBuf.size(), in)) > 0) {
+            size_t n = prep.feed(inBuf.data(), len, outBuf.data());
+            lookupDigraphs(pairs, cell, outBuf.data(), n, outBuf.data());
+            if (fwrite(outBuf.data(), 1, n, out) != n) return false;
+        }
+        size_t n = prep.finish(outBuf.data());
+        lookupDigraphs(pairs, cell, outBuf.data(), n, outBuf.data());
+        if (fwrite(outBuf.data(), 1, n, out) != n) return false;
+        return !ferror(in) && fflush(out) == 0;
+    }
+
+    void printKeyTable() {
+        for (int i = 0; i < 25; i++) {
+            cout << keyTable[i] << ' ';
+            if (i % 5 == 4) cout << "\n";
+        }
+    }
+};
+
+// The original map-based implementation, kept as the baseline for --bench
+class MapPlayfairCipher {
     vector<vector<char>> keyTable;
     map<char, pair<int, int>> pos; // letter -> (row, col)
 
 public:
-    PlayfairCipher(string key) {
+    MapPlayfairCipher(string key) {
         createKeyTable(key);
     }
 
@@ -151,7 +357,103 @@ public:
     }
 };
 
-int main() {
+double secondsSince(chrono::steady_clock::time_point start) {
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+// Check the table-driven class against MapPlayfairCipher and compare speed
+int runBenchmark(size_t mib) {
+    const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz ,.";
+    string text(mib << 20, ' ');
+    unsigned int seed = 3;
+    for (char &c : text) {
+        seed = seed * 1103515245 + 12345;
+        c = alphabet[(seed >> 16) % (sizeof(alphabet) - 1)];
+    }
+
+    const string keys[] = {"monarchy", "playfair example", "", "JJJ zebra"};
+    for (const string &key : keys) {
+        PlayfairCipher fast(key);
+        MapPlayfairCipher ref(key);
+        string sample = text.substr(0, 100000);
+        string enc = ref.encrypt(sample);
+        if (fast.encrypt(sample) != enc || fast.decrypt(enc) != ref.decrypt(enc)) {
+            cout << "Mismatch with the map-based class, key \"" << key << "\"\n";
+            return 1;
+        }
+
+        // Streaming with a tiny buffer splits digraphs across reads
+        FILE *in = tmpfile(), *out = tmpfile();
+        if (!in || !out) {
+            cout << "Could not create temporary files\n";
+            return 1;
+        }
+        fwrite(sample.data(), 1, sample.size(), in);
+        rewind(in);
+        bool ok = fast.transformStream(in, out, true, 7);
+        string streamed(ftell(out), '\0');
+        rewind(out);
+        ok = ok && fread(&streamed[0], 1, streamed.size(), out) == streamed.size();
+        fclose(in);
+        fclose(out);
+        if (!ok || streamed != enc) {
+            cout << "Streaming mismatch, key \"" << key << "\"\n";
+            return 1;
+        }
+    }
+
+    PlayfairCipher fast("monarchy");
+    MapPlayfairCipher ref("monarchy");
+    double mb = double(text.size()) / (1 << 20);
+
+    auto start = chrono::steady_clock::now();
+    string encRef = ref.encrypt(text);
+    double tEncRef = secondsSince(start);
+    start = chrono::steady_clock::now();
+    string decRef = ref.decrypt(encRef);
+    double tDecRef = secondsSince(start);
+
+    start = chrono::steady_clock::now();
+    string enc = fast.encrypt(text);
+    double tEnc = secondsSince(start);
+    start = chrono::steady_clock::now();
+    string dec = fast.decrypt(enc);
+    double tDec = secondsSince(start);
+
+    if (enc != encRef || dec != decRef) {
+        cout << "Mismatch on benchmark text\n";
+        return 1;
+    }
+    cout << "Playfair throughput over " << mib << " MiB of plaintext\n";
+    cout << "  map-based   encrypt: " << mb / tEncRef << " MB/s, decrypt: " << mb / tDecRef << " MB/s\n";
+    cout << "  table-based encrypt: " << mb / tEnc << " MB/s, decrypt: " << mb / tDec << " MB/s\n";
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc > 1 && string(argv[1]) == "--bench") {
+        size_t mib = argc > 2 ? strtoul(argv[2], nullptr, 10) : 32;
+        return runBenchmark(mib ? mib : 32);
+    }
+
+    if (argc > 2 && (string(argv[1]) == "-e" || string(argv[1]) == "-d")) {
+        PlayfairCipher cipher(argv[2]);
+        FILE *in = stdin, *out = stdout;
+        if (argc > 3 && !(in = fopen(argv[3], "rb"))) {
+            cerr << "Cannot open " << argv[3] << "\n";
+            return 1;
+        }
+        if (argc > 4 && !(out = fopen(argv[4], "wb"))) {
+            cerr << "Cannot open " << argv[4] << "\n";
+            return 1;
+        }
+        bool ok = cipher.transformStream(in, out, string(argv[1]) == "-e");
+        if (in != stdin) fclose(in);
+        if (out != stdout && fclose(out) != 0) ok = false;
+        if (!ok) cerr << "I/O error while streaming\n";
+        return ok ? 0 : 1;
+    }
+
     string key, plaintext;
 
     cout << "Enter key: ";
@@ -2,8 +2,16 @@
 //Encryption/Decryption: Based on substitution, using multiple substitution
 //Alphabets
 //implementing Vigenere cipher
+//
+//   ./exp4 --bench [MiB]    check the vectorized kernel and the engine, report MB/s
 #include <iostream>
 #include <string>
+#include <cstdlib>
+#include <chrono>
+#include <vector>
+#include <stdexcept>
+#include "shift_kernel.h"
+#include "parallel_chunks.h"
 using namespace std;
 
 // Function to generate repeating key (ignores non-alphabet characters)
@@ -21,8 +29,9 @@ string generateKey(const string &text, const string &key) {
     return newKey;
 }
 
-// Encrypt function
-string encryptText(const string &text, const string &key) {
+// Straightforward per-character versions, kept as the reference the
+// vectorized kernel is checked against
+string encryptTextReference(const string &text, const string &key) {
     string cipher_text;
     for (size_t i = 0; i < text.size(); i++) {
         if (isupper(text[i])) {
@@ -38,8 +47,7 @@ string encryptText(const string &text, const string &key) {
     return cipher_text;
 }
 
-// Decrypt function
-string decryptText(const string &cipher_text, const string &key) {
+string decryptTextReference(const string &cipher_text, const string &key) {
     string orig_text;
     for (size_t i = 0; i < cipher_text.size(); i++) {
         if (isupper(cipher_text[i])) {
@@ -55,7 +63,198 @@ string decryptText(const string &cipher_text, const string &key) {
     return orig_text;
 }
 
-int main() {
+// Encrypt function (key must be at least as long as text, see generateKey)
+string encryptText(const string &text, const string &key) {
+    string cipher_text(text.size(), '\0');
+    shiftkernel::shiftKeyed(text.data(), key.data(), &cipher_text[0], text.size(), false);
+    return cipher_text;
+}
+
+// Decrypt function
+string decryptText(const string &cipher_text, const string &key) {
+    string orig_text(cipher_text.size(), '\0');
+    shiftkernel::shiftKeyed(cipher_text.data(), key.data(), &orig_text[0], cipher_text.size(), true);
+    return orig_text;
+}
+
+// Number of letters in text[0..len); the key advances only on these
+size_t countLetters(const char *text, size_t len) {
+    return shiftkernel::countLetters(text, len);
+}
+
+// Vigenere without the expanded key. The key letter for a byte is
+// keyword[lettersBefore % keyword.size()], so any range of the text can be
+// transformed on its own once the number of letters before it is known.
+class VigenereEngine {
+    static const size_t SLICE = 4096;
+    string keyword;
+    string repeated; // keyword repeated past keyword.size() + SLICE letters
+
+public:
+    explicit VigenereEngine(const string &kw) : keyword(kw) {
+        if (keyword.empty()) throw invalid_argument("Key must not be empty");
+        for (char c : keyword)
+            if (!isalpha((unsigned char)c)) throw invalid_argument("Key must contain letters only");
+        while (repeated.size() < keyword.size() + SLICE) repeated += keyword;
+    }
+
+    // Transform in[0..len) into out, given the letter count before in[0]
+    void transform(const char *in, char *out, size_t len, size_t lettersBefore, bool decrypt) const {
+        size_t k = lettersBefore % keyword.size();
+        for (size_t off = 0; off < len; off += SLICE) {
+            size_t n = min(SLICE, len - off);
+            // k grows by at most n inside a slice, so repeated is long enough
+            k = shiftkernel::shiftRunning(in + off, out + off, n, repeated.data(), k, decrypt);
+            k %= keyword.size();
+        }
+    }
+
+    // Whole-text transform: count letters per chunk in parallel, prefix-sum
+    // the counts into each chunk's key offset, then transform the chunks
+    string apply(const string &text, bool decrypt, ChunkPool &pool = ChunkPool::shared()) const {
+        const size_t chunk = PARALLEL_CHUNK_SIZE;
+        vector<size_t> before((text.size() + chunk - 1) / chunk);
+        pool.run(text.size(), chunk, 1, [&](size_t b, size_t e) {
+            before[b / chunk] = countLetters(text.data() + b, e - b);
+        });
+        size_t total = 0;
+        for (size_t &count : before) {
+            size_t here = count;
+            count = total;
+            total += here;
+        }
+
+        string out(text.size(), '\0');
+        pool.run(text.size(), chunk, 1, [&](size_t b, size_t e) {
+            transform(text.data() + b, &out[b], e - b, before[b / chunk], decrypt);
+        });
+        return out;
+    }
+
+    string encrypt(const string &text, ChunkPool &pool = ChunkPool::shared()) const {
+        return apply(text, false, pool);
+    }
+
+    string decrypt(const string &text, ChunkPool &pool = ChunkPool::shared()) const {
+        return apply(text, true, pool);
+    }
+};
+
+// Fill a string with pseudo-random mixed-case text and punctuation
+string sampleText(size_t len) {
+    const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz"
+                            "abcdefghijklmnopqrstuvwxyz0123456789 ,.;!?-\n";
+    string text(len, ' ');
+    unsigned int seed = 2024;
+    for (size_t i = 0; i < len; i++) {
+        seed = seed * 1103515245 + 12345;
+        text[i] = alphabet[(seed >> 16) % (sizeof(alphabet) - 1)];
+    }
+    return text;
+}
+
+double secondsSince(chrono::steady_clock::time_point start) {
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+// Check every kernel backend against the reference functions (all 256 byte
+// values, several keys), then report MB/s for each of them.
+int runBenchmark(size_t mib) {
+    string text = sampleText(4096);
+    for (int c = 0; c < 256; c++) text.push_back(char(c));
+    const string keywords[] = {"LEMON", "a", "Zebra", "qwertyuiopasdfghjklzxcvbnm"};
+
+    for (int b = shiftkernel::Scalar; b <= shiftkernel::AVX2; b++) {
+        auto backend = shiftkernel::Backend(b);
+        if (!shiftkernel::supported(backend)) continue;
+        for (const string &keyword : keywords) {
+            string key = generateKey(text, keyword);
+            string enc(text.size(), '\0'), dec(text.size(), '\0');
+            shiftkernel::shiftKeyed(backend, text.data(), key.data(), &enc[0], text.size(), false);
+            shiftkernel::shiftKeyed(backend, enc.data(), key.data(), &dec[0], enc.size(), true);
+            if (enc != encryptTextReference(text, key) || dec != decryptTextReference(enc, key)) {
+                cout << "Mismatch: " << shiftkernel::backendName(backend)
+                     << " kernel, key " << keyword << endl;
+                return 1;
+            }
+        }
+    }
+    cout << "All kernels match encryptText/decryptText reference\n";
+
+    // The engine must agree with the expanded-key functions, including when
+    // it starts at an arbitrary offset
+    unsigned int pick = 1;
+    for (const string &keyword : keywords) {
+        VigenereEngine engine(keyword);
+        string key = generateKey(text, keyword);
+        string enc = encryptText(text, key);
+        if (engine.encrypt(text) != enc || engine.decrypt(enc) != text) {
+            cout << "Engine mismatch, key " << keyword << endl;
+            return 1;
+        }
+        for (int trial = 0; trial < 100; trial++) {
+            pick = pick * 1103515245 + 12345;
+            size_t off = (pick >> 8) % text.size();
+            size_t len = min(text.size() - off, size_t(pick % 600));
+            string part(len, '\0');
+            engine.transform(&enc[off], &part[0], len, countLetters(enc.data(), off), true);
+            if (part != text.substr(off, len)) {
+                cout << "Engine mismatch at offset " << off << ", key " << keyword << endl;
+                return 1;
+            }
+        }
+    }
+    cout << "VigenereEngine matches, including random-offset decryption\n";
+
+    text = sampleText(mib << 20);
+    string key = generateKey(text, "LEMON");
+    double mb = double(text.size()) / (1 << 20);
+
+    auto start = chrono::steady_clock::now();
+    string ref = encryptTextReference(text, key);
+    cout << "Vigenere throughput over " << mib << " MiB\n";
+    cout << "  reference      : " << mb / secondsSince(start) << " MB/s\n";
+
+    string out(text.size(), '\0');
+    for (int b = shiftkernel::Scalar; b <= shiftkernel::AVX2; b++) {
+        auto backend = shiftkernel::Backend(b);
+        if (!shiftkernel::supported(backend)) continue;
+        start = chrono::steady_clock::now();
+        shiftkernel::shiftKeyed(backend, text.data(), key.data(), &out[0], text.size(), false);
+        double t = secondsSince(start);
+        string label = shiftkernel::backendName(backend);
+        label.resize(15, ' ');
+        cout << "  " << label << ": " << mb / t << " MB/s\n";
+        if (out != ref) {
+            cout << "Mismatch on benchmark text\n";
+            return 1;
+        }
+    }
+
+    // Engine from 1 to N threads, no expanded key
+    VigenereEngine engine("LEMON");
+    double tOne = 0;
+    for (unsigned threads : scalingThreadCounts()) {
+        ChunkPool pool(threads);
+        start = chrono::steady_clock::now();
+        string enc = engine.encrypt(text, pool);
+        double t = secondsSince(start);
+        if (threads == 1) tOne = t;
+        cout << "  engine, " << threads << " thr : " << mb / t << " MB/s, speedup " << tOne / t << "x\n";
+        if (enc != ref) {
+            cout << "Engine mismatch on benchmark text\n";
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc > 1 && string(argv[1]) == "--bench") {
+        size_t mib = argc > 2 ? strtoul(argv[2], nullptr, 10) : 128;
+        return runBenchmark(mib ? mib : 128);
+    }
+
     string text, keyword;
 
     cout << "Enter plaintext: ";
@@ -64,11 +263,16 @@ int main() {
     cout << "Enter key (letters only): ";
     cin >> keyword;
 
-    string key = generateKey(text, keyword);
-    string cipher_text = encryptText(text, key);
+    try {
+        VigenereEngine engine(keyword);
+        string cipher_text = engine.encrypt(text);
 
-    cout << "\nEncrypted Text : " << cipher_text << endl;
-    cout << "Decrypted Text : " << decryptText(cipher_text, key) << endl;
+        cout << "\nEncrypted Text : " << cipher_text << endl;
+        cout << "Decrypted Text : " << engine.decrypt(cipher_text) << endl;
+    } catch (const exception &e) {
+        cout << "Error: " << e.what() << endl;
+        return 1;
+    }
 
     return 0;
 }
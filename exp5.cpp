@@ -1,8 +1,18 @@
 // To implement Hill- cipher encryption decryption
+//
+//   ./exp5 --bench [MiB]    fixed-size and batched kernels vs generic loop, 1 to N threads
 #include <iostream>
 #include <vector>
 #include <string>
 #include <algorithm>
+#include <stdexcept>
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <cstdlib>
+#include <chrono>
+#include "parallel_chunks.h"
 using namespace std;
 
 // Function to get modulo inverse of a number under mod 26
@@ -14,78 +24,216 @@ int modInverse(int a, int m) {
 	return -1;
 }
 
-// Function to get determinant of matrix (only for 2x2 and 3x3)
-int determinant(const vector<vector<int>> &mat, int n) {
-	if (n == 2)
-		return (mat[0][0]*mat[1][1] - mat[0][1]*mat[1][0]);
-	else if (n == 3)
-		return (mat[0][0]*(mat[1][1]*mat[2][2] - mat[1][2]*mat[2][1])
-				- mat[0][1]*(mat[1][0]*mat[2][2] - mat[1][2]*mat[2][0])
-				+ mat[0][2]*(mat[1][0]*mat[2][1] - mat[1][1]*mat[2][0]));
-	return 0;
-}
+// Gauss-Jordan elimination of mat mod a prime p. Returns the determinant
+// mod p; when it is non-zero, inv receives the inverse mod p.
+int gaussJordanModPrime(const vector<vector<int>> &mat, int n, int p, vector<vector<int>> &inv) {
+	vector<vector<int>> a(n, vector<int>(n));
+	inv.assign(n, vector<int>(n, 0));
+	for (int i = 0; i < n; i++) {
+		for (int j = 0; j < n; j++) a[i][j] = (mat[i][j] % p + p) % p;
+		inv[i][i] = 1;
+	}
 
-// Function to get adjoint of 2x2 or 3x3 matrix
-vector<vector<int>> adjoint(const vector<vector<int>> &mat, int n) {
-	vector<vector<int>> adj(n, vector<int>(n));
-	if (n == 2) {
-		adj[0][0] = mat[1][1];
-		adj[0][1] = -mat[0][1];
-		adj[1][0] = -mat[1][0];
-		adj[1][1] = mat[0][0];
-	} else if (n == 3) {
-		for (int i = 0; i < n; i++) {
+	int det = 1;
+	for (int col = 0; col < n; col++) {
+		int pivot = col;
+		while (pivot < n && a[pivot][col] == 0) pivot++;
+		if (pivot == n) return 0;
+		if (pivot != col) {
+			swap(a[pivot], a[col]);
+			swap(inv[pivot], inv[col]);
+			det = p - det; // a row swap flips the sign
+		}
+		det = det * a[col][col] % p;
+
+		int scale = modInverse(a[col][col], p);
+		for (int j = 0; j < n; j++) {
+			a[col][j] = a[col][j] * scale % p;
+			inv[col][j] = inv[col][j] * scale % p;
+		}
+		for (int r = 0; r < n; r++) {
+			int f = a[r][col];
+			if (r == col || f == 0) continue;
 			for (int j = 0; j < n; j++) {
-				vector<vector<int>> temp(2, vector<int>(2));
-				int r = 0;
-				for (int k = 0; k < n; k++) {
-					if (k == i) continue;
-					int c = 0;
-					for (int l = 0; l < n; l++) {
-						if (l == j) continue;
-						temp[r][c] = mat[k][l];
-						c++;
-					}
-					r++;
-				}
-				adj[j][i] = ((temp[0][0]*temp[1][1] - temp[0][1]*temp[1][0]) * (((i+j)%2==0)?1:-1));
+				a[r][j] = (a[r][j] + (p - f) * a[col][j]) % p;
+				inv[r][j] = (inv[r][j] + (p - f) * inv[col][j]) % p;
 			}
 		}
 	}
-	return adj;
+	return det % p;
 }
 
-// Function to get inverse of matrix mod 26
+// 26 = 2 * 13 and Z/26 is not a field, so everything is done mod 2 and
+// mod 13 separately and combined with the CRT: x = 13a + 14b (mod 26)
+// satisfies x = a (mod 2) and x = b (mod 13).
+int crt26(int mod2, int mod13) {
+	return (13 * mod2 + 14 * mod13) % 26;
+}
+
+// Function to get determinant of matrix mod 26, O(n^3)
+int determinant(const vector<vector<int>> &mat, int n) {
+	vector<vector<int>> unused;
+	return crt26(gaussJordanModPrime(mat, n, 2, unused), gaussJordanModPrime(mat, n, 13, unused));
+}
+
+// Function to get inverse of matrix mod 26: it exists exactly when the
+// matrix is invertible mod 2 and mod 13
 vector<vector<int>> inverseMatrix(const vector<vector<int>> &mat, int n) {
-	int det = determinant(mat, n);
-	det = (det % 26 + 26) % 26;
-	int invDet = modInverse(det, 26);
-	if (invDet == -1) {
+	vector<vector<int>> inv2, inv13;
+	if (gaussJordanModPrime(mat, n, 2, inv2) == 0 || gaussJordanModPrime(mat, n, 13, inv13) == 0) {
 		throw runtime_error("Key matrix is not invertible mod 26");
 	}
-	vector<vector<int>> adj = adjoint(mat, n);
 	vector<vector<int>> inv(n, vector<int>(n));
-	for (int i = 0; i < n; i++) {
-		for (int j = 0; j < n; j++) {
-			int val = adj[i][j] * invDet;
-			val = (val % 26 + 26) % 26;
-			inv[i][j] = val;
+	for (int i = 0; i < n; i++)
+		for (int j = 0; j < n; j++)
+			inv[i][j] = crt26(inv2[i][j], inv13[i][j]);
+	return inv;
+}
+
+// Multiply every n-letter block of t[0..len) by mat mod 26, in place.
+// len must be a multiple of n. Generic reference for the fixed-size kernels.
+void hillTransform(char *t, size_t len, const vector<vector<int>> &mat, int n) {
+	vector<int> block(n);
+	for (size_t i = 0; i + n <= len; i += n) {
+		for (int j = 0; j < n; j++) block[j] = t[i+j] - 'A';
+		for (int r = 0; r < n; r++) {
+			int sum = 0;
+			for (int j = 0; j < n; j++) {
+				sum += mat[r][j] * block[j];
+			}
+			t[i+r] = (sum % 26 + 26) % 26 + 'A';
 		}
 	}
-	return inv;
 }
 
-// Function to multiply matrix and vector mod 26
-vector<int> multiply(const vector<vector<int>> &mat, const vector<int> &vec, int n) {
-	vector<int> res(n);
-	for (int i = 0; i < n; i++) {
-		int sum = 0;
-		for (int j = 0; j < n; j++) {
-			sum += mat[i][j] * vec[j];
+// Interface the runtime n is dispatched through; one virtual call per
+// chunk, never per block. A kernel multiplies by one matrix: the key to
+// encrypt, or its inverse to decrypt (see makeHillCipher).
+struct HillKernel {
+	virtual ~HillKernel() {}
+	virtual void transform(char *t, size_t len) const = 0;
+};
+
+// Hill cipher with the block size fixed at compile time. The matrix lives
+// in a std::array and every block is multiplied by a fully unrolled dot
+// product on the stack.
+template <int N>
+class HillCipher : public HillKernel {
+	typedef array<array<int, N>, N> Matrix;
+	Matrix mat;
+
+	template <size_t... J>
+	static int dot(const array<int, N> &row, const int *block, index_sequence<J...>) {
+		return ((row[J] * block[J]) + ...);
+	}
+
+	template <size_t... R>
+	static void multiplyBlock(const Matrix &m, char *t, index_sequence<R...> seq) {
+		int block[N] = {};
+		((block[R] = t[R] - 'A'), ...);
+		((t[R] = char(dot(m[R], block, seq) % 26 + 'A')), ...);
+	}
+
+	static void apply(const Matrix &m, char *t, size_t len) {
+		for (size_t i = 0; i + N <= len; i += N)
+			multiplyBlock(m, t + i, make_index_sequence<N>());
+	}
+
+	static Matrix toArray(const vector<vector<int>> &mat) {
+		Matrix m;
+		for (int i = 0; i < N; i++)
+			for (int j = 0; j < N; j++)
+				m[i][j] = (mat[i][j] % 26 + 26) % 26;
+		return m;
+	}
+
+public:
+	explicit HillCipher(const vector<vector<int>> &m) : mat(toArray(m)) {}
+
+	void transform(char *t, size_t len) const override { apply(mat, t, len); }
+};
+
+// Any block size: blocks are multiplied BATCH at a time as a small GEMM.
+// A tile of blocks is transposed so that block b, letter k sits at
+// tile[k][b]; then out[i][b] = sum_k K[i][k] * tile[k][b] is a run of
+// multiply-adds over contiguous b that the compiler vectorizes. Sums stay
+// below n * 25 * 25, which fits 16 bits for n <= MAX_N.
+class HillBatched : public HillKernel {
+	static const int BATCH = 64;
+	int n;
+	vector<uint16_t> mat;
+
+	static vector<uint16_t> flatten(const vector<vector<int>> &mat, int n) {
+		vector<uint16_t> m(n * n);
+		for (int i = 0; i < n; i++)
+			for (int j = 0; j < n; j++)
+				m[i * n + j] = (mat[i][j] % 26 + 26) % 26;
+		return m;
+	}
+
+	void apply(const vector<uint16_t> &m, char *t, size_t len) const {
+		vector<uint16_t> tile(n * BATCH); // one allocation per chunk
+		uint16_t acc[BATCH];
+		char out[BATCH];
+		size_t blocks = len / n;
+		for (size_t first = 0; first < blocks; first += BATCH) {
+			int count = (int)min<size_t>(BATCH, blocks - first);
+			char *base = t + first * n;
+			for (int b = 0; b < count; b++)
+				for (int k = 0; k < n; k++)
+					tile[k * BATCH + b] = base[b * n + k] - 'A';
+
+			for (int i = 0; i < n; i++) {
+				for (int b = 0; b < BATCH; b++) acc[b] = 0;
+				for (int k = 0; k < n; k++) {
+					uint16_t kik = m[i * n + k];
+					const uint16_t *row = &tile[k * BATCH];
+					for (int b = 0; b < BATCH; b++) acc[b] += kik * row[b];
+				}
+				for (int b = 0; b < BATCH; b++) out[b] = char(acc[b] % 26 + 'A');
+				for (int b = 0; b < count; b++) base[b * n + i] = out[b];
+			}
 		}
-		res[i] = (sum % 26 + 26) % 26;
 	}
-	return res;
+
+public:
+	static const int MAX_N = 64;
+
+	HillBatched(const vector<vector<int>> &m, int size) : n(size), mat(flatten(m, size)) {}
+
+	void transform(char *t, size_t len) const override { apply(mat, t, len); }
+};
+
+const int MAX_FIXED_N = 8;
+
+// Build the kernel for one key once, before any text is processed: the
+// HillCipher<N> matching the runtime key size, or the batched kernel for
+// sizes without one. Only a decrypting kernel inverts the key, so a
+// non-invertible key is reported here, not from a worker thread.
+unique_ptr<HillKernel> makeHillCipher(const vector<vector<int>> &key, int n, bool decrypt = false) {
+	if (n < 1 || n > HillBatched::MAX_N)
+		throw invalid_argument("Key matrix size must be between 1 and " + to_string(HillBatched::MAX_N));
+	vector<vector<int>> inv;
+	if (decrypt) inv = inverseMatrix(key, n);
+	const vector<vector<int>> &m = decrypt ? inv : key;
+	switch (n) {
+	case 2: return unique_ptr<HillKernel>(new HillCipher<2>(m));
+	case 3: return unique_ptr<HillKernel>(new HillCipher<3>(m));
+	case 4: return unique_ptr<HillKernel>(new HillCipher<4>(m));
+	case 5: return unique_ptr<HillKernel>(new HillCipher<5>(m));
+	case 6: return unique_ptr<HillKernel>(new HillCipher<6>(m));
+	case 7: return unique_ptr<HillKernel>(new HillCipher<7>(m));
+	case 8: return unique_ptr<HillKernel>(new HillCipher<8>(m));
+	}
+	return unique_ptr<HillKernel>(new HillBatched(m, n));
+}
+
+// Blocks are independent, so large texts are split into chunks aligned to
+// n and transformed on the pool
+void hillTransform(string &t, const HillKernel &kernel, int n, ChunkPool &pool) {
+	pool.run(t.size(), PARALLEL_CHUNK_SIZE, n, [&](size_t b, size_t e) {
+		kernel.transform(&t[b], e - b);
+	});
 }
 
 string processText(const string &text, int n) {
@@ -96,37 +244,131 @@ string processText(const string &text, int n) {
 	return t;
 }
 
-string encrypt(const string &plaintext, const vector<vector<int>> &key, int n) {
-	string pt = processText(plaintext, n);
-	string ct;
-	for (size_t i = 0; i < pt.size(); i += n) {
-		vector<int> block(n);
-		for (int j = 0; j < n; j++) block[j] = pt[i+j] - 'A';
-		vector<int> enc = multiply(key, block, n);
-		for (int j = 0; j < n; j++) ct += (enc[j] + 'A');
-	}
+// cipher comes from makeHillCipher(key, n)
+string encrypt(const string &plaintext, const HillKernel &cipher, int n,
+               ChunkPool &pool = ChunkPool::shared()) {
+	string ct = processText(plaintext, n);
+	hillTransform(ct, cipher, n, pool);
 	return ct;
 }
 
-string decrypt(const string &ciphertext, const vector<vector<int>> &key, int n) {
-	vector<vector<int>> invKey = inverseMatrix(key, n);
-	string ct = processText(ciphertext, n);
-	string pt;
-	for (size_t i = 0; i < ct.size(); i += n) {
-		vector<int> block(n);
-		for (int j = 0; j < n; j++) block[j] = ct[i+j] - 'A';
-		vector<int> dec = multiply(invKey, block, n);
-		for (int j = 0; j < n; j++) pt += (dec[j] + 'A');
-	}
+// decipher comes from makeHillCipher(key, n, true)
+string decrypt(const string &ciphertext, const HillKernel &decipher, int n,
+               ChunkPool &pool = ChunkPool::shared()) {
+	string pt = processText(ciphertext, n);
+	hillTransform(pt, decipher, n, pool);
 	return pt;
 }
 
-int main() {
+double secondsSince(chrono::steady_clock::time_point start) {
+	return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+// Random n x n key that is invertible mod 26
+vector<vector<int>> randomInvertibleKey(int n, unsigned int &seed) {
+	vector<vector<int>> key(n, vector<int>(n));
+	for (;;) {
+		for (auto &row : key)
+			for (int &v : row) {
+				seed = seed * 1103515245 + 12345;
+				v = (seed >> 16) % 26;
+			}
+		int det = determinant(key, n);
+		if (det % 2 != 0 && det % 13 != 0) return key;
+	}
+}
+
+// Time one kernel encrypting a copy of text in place; returns MB/s
+double kernelThroughput(const HillKernel &cipher, const string &text, string &out) {
+	out = text;
+	auto start = chrono::steady_clock::now();
+	cipher.transform(&out[0], out.size());
+	return double(text.size()) / (1 << 20) / secondsSince(start);
+}
+
+// Check the inverse, the fixed-size and the batched kernels against the
+// generic loop, then report the single-thread speed of each and the 1..N
+// thread scaling
+int runBenchmark(size_t mib) {
+	unsigned int seed = 99;
+	string letters(mib << 20, 'A');
+	for (char &c : letters) {
+		seed = seed * 1103515245 + 12345;
+		c = 'A' + (seed >> 16) % 26;
+	}
+
+	cout << "Hill encryption over " << mib << " MiB, one thread (MB/s)\n";
+	ChunkPool single(1);
+	const int sizes[] = {2, 3, 4, 5, 6, 7, 8, 12, 16, 32, 64};
+	for (int n : sizes) {
+		string text = letters.substr(0, letters.size() / n * n);
+		vector<vector<int>> key = randomInvertibleKey(n, seed);
+		vector<vector<int>> inv = inverseMatrix(key, n);
+		for (int i = 0; i < n; i++)
+			for (int j = 0; j < n; j++) {
+				int sum = 0;
+				for (int k = 0; k < n; k++) sum += key[i][k] * inv[k][j];
+				if (sum % 26 != (i == j)) {
+					cout << "Inverse of the " << n << "x" << n << " key is wrong\n";
+					return 1;
+				}
+			}
+
+		string generic = text, fixed, batched;
+		auto start = chrono::steady_clock::now();
+		hillTransform(&generic[0], generic.size(), key, n);
+		double tGeneric = double(text.size()) / (1 << 20) / secondsSince(start);
+		double tBatched = kernelThroughput(HillBatched(key, n), text, batched);
+		cout << "  n=" << n << (n < 10 ? " " : "") << "  generic: " << tGeneric << "  batched: " << tBatched;
+		bool ok = batched == generic;
+		if (n <= MAX_FIXED_N) {
+			double tFixed = kernelThroughput(*makeHillCipher(key, n), text, fixed);
+			cout << "  HillCipher<" << n << ">: " << tFixed;
+			ok = ok && fixed == generic;
+		}
+		cout << "\n";
+		if (!ok || decrypt(generic, *makeHillCipher(key, n, true), n, single) != text) {
+			cout << "Kernels for n=" << n << " do not match the generic loop\n";
+			return 1;
+		}
+	}
+
+	string text = letters.substr(0, letters.size() / 3 * 3);
+	double mb = double(text.size()) / (1 << 20);
+	vector<vector<int>> key = {{6, 24, 1}, {13, 16, 10}, {20, 17, 15}};
+	int n = 3;
+	double tOne = 0;
+	string expected;
+	unique_ptr<HillKernel> cipher = makeHillCipher(key, n);
+	cout << "Hill " << n << "x" << n << " scaling\n";
+	for (unsigned threads : scalingThreadCounts()) {
+		ChunkPool pool(threads);
+		auto start = chrono::steady_clock::now();
+		string ct = encrypt(text, *cipher, n, pool);
+		double t = secondsSince(start);
+		if (threads == 1) {
+			tOne = t;
+			expected = ct;
+		} else if (ct != expected) {
+			cout << "Output with " << threads << " threads differs from one thread\n";
+			return 1;
+		}
+		cout << "  " << threads << " thread(s): " << mb / t << " MB/s, speedup " << tOne / t << "x\n";
+	}
+	return 0;
+}
+
+int main(int argc, char *argv[]) {
+	if (argc > 1 && string(argv[1]) == "--bench") {
+		size_t mib = argc > 2 ? strtoul(argv[2], nullptr, 10) : 128;
+		return runBenchmark(mib ? mib : 128);
+	}
+
 	int n;
-	cout << "Enter size of key matrix (2 or 3): ";
+	cout << "Enter size of key matrix (2 to " << HillBatched::MAX_N << "): ";
 	cin >> n;
-	if (n != 2 && n != 3) {
-		cout << "Only 2x2 or 3x3 matrices supported.\n";
+	if (n < 2 || n > HillBatched::MAX_N) {
+		cout << "Only 2x2 to " << HillBatched::MAX_N << "x" << HillBatched::MAX_N << " matrices supported.\n";
 		return 1;
 	}
 	vector<vector<int>> key(n, vector<int>(n));
@@ -143,10 +385,10 @@ int main() {
 	cin >> choice;
 	try {
 		if (choice == 1) {
-			string ct = encrypt(text, key, n);
+			string ct = encrypt(text, *makeHillCipher(key, n), n);
 			cout << "Encrypted text: " << ct << endl;
 		} else if (choice == 2) {
-			string pt = decrypt(text, key, n);
+			string pt = decrypt(text, *makeHillCipher(key, n, true), n);
 			cout << "Decrypted text: " << pt << endl;
 		} else {
 			cout << "Invalid choice.\n";
@@ -1,7 +1,20 @@
-// to implement S-DES sub key generation 
+// to implement S-DES sub key generation
+//
+// Besides the subkeys, this file has a full S-DES encrypt/decrypt built on
+// them: a table-driven version working on integers, and a bit-sliced one
+// that pushes 64 (uint64_t) or 256 (4 x uint64_t vector) blocks through
+// each boolean operation.
+//   ./exp6 -e|-d <10-bit key> <8-bit block>    encrypt or decrypt one block
+//   ./exp6 --crack <P:C> [<P:C> ...]           find every key mapping P to C
+//   ./exp6 --bench                             known-answer tests + blocks/s
 #include <iostream>
 #include <string>
 #include <vector>
+#include <utility>
+#include <cstdint>
+#include <cstring>
+#include <chrono>
+#include "parallel_chunks.h"
 
 using namespace std;
 
@@ -19,12 +32,12 @@ string leftShift(const string& bits) {
     return bits.substr(1) + bits[0]; // Shift left
 }
 
+// P10 and P8 permutation tables
+const vector<int> P10 = {3, 5, 2, 7, 4, 10, 1, 9, 8, 6};
+const vector<int> P8 = {6, 3, 7, 4, 8, 5, 10, 9};
+
 // Function to generate subkeys K1 and K2 from the given key
 void generateSubkeys(const string& key, string& K1, string& K2) {
-    // P10 and P8 permutation tables
-    vector<int> P10 = {3, 5, 2, 7, 4, 10, 1, 9, 8, 6};
-    vector<int> P8 = {6, 3, 7, 4, 8, 5, 10, 9};
-
     // Step 1: Permute the key using P10
     string permutedKey = permute(key, P10);
 
@@ -37,15 +50,629 @@ void generateSubkeys(const string& key, string& K1, string& K2) {
     rightHalf = leftShift(rightHalf);
     K1 = permute(leftHalf + rightHalf, P8);
 
-    // Step 4: Generate K2
-    leftHalf = leftShift(leftHalf);
-    rightHalf = leftShift(rightHalf);
+    // Step 4: Generate K2 (LS-2: shift both halves by two more places)
+    leftHalf = leftShift(leftShift(leftHalf));
+    rightHalf = leftShift(leftShift(rightHalf));
     K2 = permute(leftHalf + rightHalf, P8);
 }
 
-int main() {
+// ---------------------------------------------------------------------------
+// S-DES encryption. Bit strings become integers whose most significant bit
+// is the leftmost character, so the 1-based tables apply unchanged.
+
+const int IP[8] = {2, 6, 3, 1, 4, 8, 5, 7};
+const int IP_INV[8] = {4, 1, 3, 5, 7, 2, 8, 6};
+const int EP[8] = {4, 1, 2, 3, 2, 3, 4, 1};
+const int P4[4] = {2, 4, 3, 1};
+constexpr int S0[4][4] = {{1, 0, 3, 2}, {3, 2, 1, 0}, {0, 2, 1, 3}, {3, 1, 3, 2}};
+constexpr int S1[4][4] = {{0, 1, 2, 3}, {2, 0, 1, 3}, {3, 0, 1, 0}, {2, 1, 0, 3}};
+
+// "1010" -> 0b1010
+unsigned bitsToInt(const string& bits) {
+    unsigned value = 0;
+    for (char c : bits) value = (value << 1) | (c == '1');
+    return value;
+}
+
+// 0b1010, 4 -> "1010"
+string intToBits(unsigned value, int width) {
+    string bits(width, '0');
+    for (int i = 0; i < width; i++)
+        if (value >> (width - 1 - i) & 1) bits[i] = '1';
+    return bits;
+}
+
+// Output bit i (from the left) is input bit table[i] of an inBits-wide value
+unsigned permuteInt(unsigned value, const int* table, int outBits, int inBits) {
+    unsigned out = 0;
+    for (int i = 0; i < outBits; i++)
+        out = (out << 1) | ((value >> (inBits - table[i])) & 1);
+    return out;
+}
+
+// S-box lookup: row from bits 1 and 4, column from bits 2 and 3
+constexpr int sbox(const int box[4][4], unsigned nibble) {
+    int row = ((nibble >> 2) & 2) | (nibble & 1);
+    int col = (nibble >> 1) & 3;
+    return box[row][col];
+}
+
+// Every per-block step of S-DES as a table lookup
+struct SdesTables {
+    uint8_t ip[256], ipInv[256];
+    uint8_t ep[16];  // 4-bit R -> expanded 8 bits
+    uint8_t sp[256]; // EP(R) ^ K -> P4(S0 || S1), the whole round function F
+
+    SdesTables() {
+        for (unsigned x = 0; x < 256; x++) {
+            ip[x] = permuteInt(x, IP, 8, 8);
+            ipInv[x] = permuteInt(x, IP_INV, 8, 8);
+            unsigned s = (sbox(S0, x >> 4) << 2) | sbox(S1, x & 15);
+            sp[x] = permuteInt(s, P4, 4, 4);
+        }
+        for (unsigned r = 0; r < 16; r++) ep[r] = permuteInt(r, EP, 8, 4);
+    }
+};
+
+const SdesTables& sdesTables() {
+    static const SdesTables tables;
+    return tables;
+}
+
+// Rotate a 5-bit half left by n places
+unsigned rotate5(unsigned half, int n) {
+    return ((half << n) | (half >> (5 - n))) & 31;
+}
+
+// generateSubkeys on integers: key is 10 bits, leftmost bit most significant
+void generateSubkeys(unsigned key, uint8_t& K1, uint8_t& K2) {
+    unsigned p = permuteInt(key, P10.data(), 10, 10);
+    unsigned left = rotate5(p >> 5, 1), right = rotate5(p & 31, 1);
+    K1 = permuteInt((left << 5) | right, P8.data(), 8, 10);
+    left = rotate5(left, 2);
+    right = rotate5(right, 2);
+    K2 = permuteInt((left << 5) | right, P8.data(), 8, 10);
+}
+
+const int KEY_COUNT = 1024;
+
+// K1/K2 for the whole 10-bit key space, computed once. The sliced copies
+// hold group g (keys 64g..64g+63) with key 64g+i in lane i: sliced1[g][j]
+// has bit j (from the left) of K1 for all 64 keys.
+struct KeySchedule {
+    uint8_t k1[KEY_COUNT], k2[KEY_COUNT];
+    uint64_t sliced1[KEY_COUNT / 64][8], sliced2[KEY_COUNT / 64][8];
+
+    KeySchedule() {
+        memset(sliced1, 0, sizeof(sliced1));
+        memset(sliced2, 0, sizeof(sliced2));
+        for (unsigned key = 0; key < KEY_COUNT; key++) {
+            generateSubkeys(key, k1[key], k2[key]);
+            for (int j = 0; j < 8; j++) {
+                sliced1[key / 64][j] |= uint64_t(k1[key] >> (7 - j) & 1) << (key % 64);
+                sliced2[key / 64][j] |= uint64_t(k2[key] >> (7 - j) & 1) << (key % 64);
+            }
+        }
+    }
+};
+
+const KeySchedule& keySchedule() {
+    static const KeySchedule schedule;
+    return schedule;
+}
+
+// Table-driven S-DES on one 8-bit block
+class SDES {
+    uint8_t k1, k2;
+
+    static uint8_t crypt(uint8_t block, uint8_t first, uint8_t second) {
+        const SdesTables& t = sdesTables();
+        unsigned x = t.ip[block];
+        unsigned L = x >> 4, R = x & 15;
+        L ^= t.sp[t.ep[R] ^ first];  // fk with the first subkey
+        unsigned tmp = L; L = R; R = tmp; // SW
+        L ^= t.sp[t.ep[R] ^ second]; // fk with the second subkey
+        return t.ipInv[(L << 4) | R];
+    }
+
+public:
+    SDES(uint8_t subkey1, uint8_t subkey2) : k1(subkey1), k2(subkey2) {}
+
+    // From a 10-bit key string, through generateSubkeys
+    explicit SDES(const string& key) {
+        string K1, K2;
+        generateSubkeys(key, K1, K2);
+        k1 = bitsToInt(K1);
+        k2 = bitsToInt(K2);
+    }
+
+    // From a 10-bit key as an integer, through the cached schedule
+    explicit SDES(unsigned key) : k1(keySchedule().k1[key & 1023]), k2(keySchedule().k2[key & 1023]) {}
+
+    uint8_t subkey1() const { return k1; }
+    uint8_t subkey2() const { return k2; }
+
+    uint8_t encrypt(uint8_t block) const { return crypt(block, k1, k2); }
+    uint8_t decrypt(uint8_t block) const { return crypt(block, k2, k1); }
+};
+
+// ---------------------------------------------------------------------------
+// Bit-sliced S-DES. Bit j (from the left) of every block lives in word j,
+// one block per bit lane, so each permutation is just a renaming of words
+// and each S-box is a small boolean circuit evaluated on all lanes at once.
+
+// Four 64-bit words that GCC and Clang map onto one AVX2 register (or two
+// SSE/NEON ones). Sliced words are passed by reference and results come
+// back through out-parameters, never by value, so no function's ABI
+// depends on whether -mavx is given.
+typedef uint64_t u64x4 __attribute__((vector_size(32)));
+
+// Lane i of a sliced word is bit i % 64 of its (i / 64)-th 64-bit word
+template <typename W> struct Lanes;
+template <> struct Lanes<uint64_t> {
+    static const int words = 1;
+    static uint64_t word(const uint64_t& w, int) { return w; }
+    static void setWord(uint64_t& w, int, uint64_t v) { w = v; }
+};
+template <> struct Lanes<u64x4> {
+    static const int words = 4;
+    static uint64_t word(const u64x4& w, int i) { return w[i]; }
+    static void setWord(u64x4& w, int i, uint64_t v) { w[i] = v; }
+};
+
+template <typename W>
+struct SlicedSubkeys {
+    W k1[8], k2[8];
+
+    // The same key in every lane: each word is all ones or all zeros
+    SlicedSubkeys(uint8_t subkey1, uint8_t subkey2) {
+        for (int j = 0; j < 8; j++) {
+            k1[j] = (subkey1 >> (7 - j) & 1) ? ~W{} : W{};
+            k2[j] = (subkey2 >> (7 - j) & 1) ? ~W{} : W{};
+        }
+    }
+};
+
+// out = x0 where sel is 0, x1 where it is 1. The loops below carry unroll
+// pragmas so that -O2 flattens the circuits the way -O3 would.
+template <typename W>
+inline void mux(W& out, const W& sel, const W& x0, const W& x1) { out = x0 ^ ((x0 ^ x1) & sel); }
+
+// Bit outBit of an S-box over all 16 inputs, input v in bit v
+constexpr unsigned truthTable(const int box[4][4], int outBit) {
+    unsigned table = 0;
+    for (unsigned v = 0; v < 16; v++)
+        if (sbox(box, v) >> outBit & 1) table |= 1u << v;
+    return table;
+}
+
+// One output bit of an S-box: its truth table reduced by a mux tree over
+// the input bits (b1..b4 from the left). The table is a compile-time
+// constant, so the all-zero/all-one leaves fold into a few gates.
+template <unsigned TABLE, typename W>
+inline void sboxBit(W& out, const W in[4]) {
+    W level[16];
+#pragma GCC unroll 16
+    for (int v = 0; v < 16; v++) level[v] = (TABLE >> v & 1) ? ~W{} : W{};
+#pragma GCC unroll 4
+    for (int bit = 3, width = 16; bit >= 0; bit--, width /= 2)
+#pragma GCC unroll 8
+        for (int v = 0; v < width / 2; v++)
+            mux(level[v], in[bit], level[2 * v], level[2 * v + 1]);
+    out = level[0];
+}
+
+// fk: L ^= F(R, K) on sliced halves
+template <typename W>
+inline void slicedRound(W L[4], const W R[4], const W k[8]) {
+    W e[8];
+#pragma GCC unroll 8
+    for (int i = 0; i < 8; i++) e[i] = R[EP[i] - 1] ^ k[i];
+    W s[4];
+    sboxBit<truthTable(S0, 1)>(s[0], e);
+    sboxBit<truthTable(S0, 0)>(s[1], e);
+    sboxBit<truthTable(S1, 1)>(s[2], e + 4);
+    sboxBit<truthTable(S1, 0)>(s[3], e + 4);
+#pragma GCC unroll 4
+    for (int i = 0; i < 4; i++) L[i] ^= s[P4[i] - 1];
+}
+
+// Encrypt (or decrypt) 64 * Lanes<W>::words blocks held in sliced form
+template <typename W>
+void slicedCrypt(W bits[8], const W first[8], const W second[8]) {
+    W L[4], R[4];
+    for (int i = 0; i < 4; i++) {
+        L[i] = bits[IP[i] - 1];
+        R[i] = bits[IP[i + 4] - 1];
+    }
+    slicedRound(L, R, first);
+    slicedRound(R, L, second); // SW folded in: the halves trade places
+    W x[8] = {R[0], R[1], R[2], R[3], L[0], L[1], L[2], L[3]};
+    for (int i = 0; i < 8; i++) bits[i] = x[IP_INV[i] - 1];
+}
+
+// Transpose an 8x8 bit matrix held one row per byte: afterwards bit i of
+// byte j is what bit j of byte i was. Its own inverse.
+inline uint64_t transpose8x8(uint64_t x) {
+    uint64_t t;
+    t = (x ^ (x >> 7)) & 0x00AA00AA00AA00AAULL;
+    x ^= t ^ (t << 7);
+    t = (x ^ (x >> 14)) & 0x0000CCCC0000CCCCULL;
+    x ^= t ^ (t << 14);
+    t = (x ^ (x >> 28)) & 0x00000000F0F0F0F0ULL;
+    x ^= t ^ (t << 28);
+    return x;
+}
+
+// 64 * Lanes<W>::words blocks -> 8 sliced words. Each run of 8 blocks is
+// one 8x8 transpose whose byte j holds bit j of those 8 blocks.
+template <typename W>
+void slice(const uint8_t* blocks, W bits[8]) {
+    for (int w = 0; w < Lanes<W>::words; w++) {
+        uint64_t plane[8] = {};
+        for (int g = 0; g < 8; g++) {
+            uint64_t rows;
+            memcpy(&rows, blocks + 64 * w + 8 * g, 8);
+            uint64_t cols = transpose8x8(rows);
+#pragma GCC unroll 8
+            for (int j = 0; j < 8; j++) plane[7 - j] |= (cols >> (8 * j) & 0xFF) << (8 * g);
+        }
+        for (int j = 0; j < 8; j++) Lanes<W>::setWord(bits[j], w, plane[j]);
+    }
+}
+
+template <typename W>
+void unslice(const W bits[8], uint8_t* blocks) {
+    for (int w = 0; w < Lanes<W>::words; w++) {
+        uint64_t plane[8];
+        for (int j = 0; j < 8; j++) plane[j] = Lanes<W>::word(bits[j], w);
+        for (int g = 0; g < 8; g++) {
+            uint64_t cols = 0;
+#pragma GCC unroll 8
+            for (int j = 0; j < 8; j++) cols |= (plane[7 - j] >> (8 * g) & 0xFF) << (8 * j);
+            uint64_t rows = transpose8x8(cols);
+            memcpy(blocks + 64 * w + 8 * g, &rows, 8);
+        }
+    }
+}
+
+// Encrypt or decrypt n blocks in place, 64 * Lanes<W>::words at a time; a short
+// last group is padded and only its real blocks are written back
+template <typename W>
+void slicedCryptBlocks(const SDES& cipher, uint8_t* blocks, size_t n, bool decrypt) {
+    SlicedSubkeys<W> keys(cipher.subkey1(), cipher.subkey2());
+    const W* first = decrypt ? keys.k2 : keys.k1;
+    const W* second = decrypt ? keys.k1 : keys.k2;
+    const int lanes = 64 * Lanes<W>::words;
+    uint8_t group[lanes];
+    for (size_t off = 0; off < n; off += lanes) {
+        size_t count = min<size_t>(lanes, n - off);
+        memset(group, 0, sizeof(group));
+        memcpy(group, blocks + off, count);
+        W bits[8];
+        slice(group, bits);
+        slicedCrypt(bits, first, second);
+        unslice(bits, group);
+        memcpy(blocks + off, group, count);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Exhaustive key search. Every lane runs the same plaintext under its own
+// key, so nothing has to be transposed: the plaintext and ciphertext bits
+// are broadcast to whole words and the keys come pre-sliced from the cache.
+
+typedef vector<pair<uint8_t, uint8_t>> KnownPairs; // (plaintext, ciphertext)
+
+// Bit i of match set iff key firstKey + i encrypts every pair correctly,
+// for the 64 * Lanes<W>::words keys starting at firstKey (a multiple of that)
+template <typename W>
+void matchKeys(W& match, unsigned firstKey, const KnownPairs& pairs) {
+    const KeySchedule& ks = keySchedule();
+    W k1[8], k2[8];
+    for (int j = 0; j < 8; j++)
+        for (int w = 0; w < Lanes<W>::words; w++) {
+            Lanes<W>::setWord(k1[j], w, ks.sliced1[firstKey / 64 + w][j]);
+            Lanes<W>::setWord(k2[j], w, ks.sliced2[firstKey / 64 + w][j]);
+        }
+
+    match = ~W{};
+    for (const auto& pc : pairs) {
+        W bits[8];
+        for (int j = 0; j < 8; j++) bits[j] = (pc.first >> (7 - j) & 1) ? ~W{} : W{};
+        slicedCrypt(bits, k1, k2);
+        for (int j = 0; j < 8; j++) match &= (pc.second >> (7 - j) & 1) ? bits[j] : ~bits[j];
+    }
+}
+
+// All keys consistent with the pairs, in increasing order. The key space
+// is split into chunks of 256 keys that the pool searches in parallel;
+// each chunk owns its own slots of found[], so no locking is needed.
+template <typename W>
+vector<unsigned> findKeys(const KnownPairs& pairs, ChunkPool& pool = ChunkPool::shared()) {
+    const unsigned lanes = 64 * Lanes<W>::words;
+    uint64_t found[KEY_COUNT / 64];
+    pool.run(KEY_COUNT, 256, lanes, [&](size_t begin, size_t end) {
+        for (size_t key = begin; key < end; key += lanes) {
+            W match;
+            matchKeys(match, unsigned(key), pairs);
+            for (int w = 0; w < Lanes<W>::words; w++) found[key / 64 + w] = Lanes<W>::word(match, w);
+        }
+    });
+
+    vector<unsigned> keys;
+    for (unsigned key = 0; key < KEY_COUNT; key++)
+        if (found[key / 64] >> (key % 64) & 1) keys.push_back(key);
+    return keys;
+}
+
+// Same search one key at a time with the table-driven cipher, as the
+// baseline the sliced search is measured against
+vector<unsigned> findKeysReference(const KnownPairs& pairs) {
+    vector<unsigned> keys;
+    for (unsigned key = 0; key < KEY_COUNT; key++) {
+        SDES cipher(key);
+        bool ok = true;
+        for (const auto& pc : pairs) ok = ok && cipher.encrypt(pc.first) == pc.second;
+        if (ok) keys.push_back(key);
+    }
+    return keys;
+}
+
+// ---------------------------------------------------------------------------
+
+bool isBinary(const string& bits, size_t length) {
+    if (bits.length() != length) return false;
+    for (char c : bits)
+        if (c != '0' && c != '1') return false;
+    return true;
+}
+
+double secondsSince(chrono::steady_clock::time_point start) {
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+// Known-answer tests (the first is the textbook example), then every
+// implementation against the table-driven one for all 256 blocks
+bool runKnownAnswerTests() {
+    struct { const char *key, *plain, *cipher; } kat[] = {
+        {"1010000010", "10010111", "00111000"},
+        {"0000000000", "00000000", "11110000"},
+        {"1111111111", "11111111", "00001111"},
+        {"0111111101", "10100010", "00111000"},
+        {"1000101110", "00111000", "00011100"},
+    };
+    bool ok = true;
+    for (auto& t : kat) {
+        SDES cipher(t.key);
+        uint8_t p = bitsToInt(t.plain), c = bitsToInt(t.cipher);
+        uint8_t sliced64[64] = {p}, sliced256[256] = {p};
+        slicedCryptBlocks<uint64_t>(cipher, sliced64, 64, false);
+        slicedCryptBlocks<u64x4>(cipher, sliced256, 256, false);
+        bool pass = cipher.encrypt(p) == c && cipher.decrypt(c) == p && sliced64[0] == c && sliced256[0] == c;
+        cout << "  key " << t.key << "  P " << t.plain << " -> C " << intToBits(cipher.encrypt(p), 8)
+             << (pass ? "  ok" : "  FAILED") << "\n";
+        ok = ok && pass;
+    }
+
+    for (unsigned key = 0; key < 1024; key += 37) {
+        SDES cipher(intToBits(key, 10));
+        uint8_t all[256], expected[256];
+        for (int b = 0; b < 256; b++) {
+            all[b] = b;
+            expected[b] = cipher.encrypt(b);
+            if (cipher.decrypt(expected[b]) != b) ok = false;
+        }
+        uint8_t a64[256], a256[256];
+        memcpy(a64, all, 256);
+        memcpy(a256, all, 256);
+        slicedCryptBlocks<uint64_t>(cipher, a64, 256, false);
+        slicedCryptBlocks<u64x4>(cipher, a256, 256, false);
+        if (memcmp(a64, expected, 256) || memcmp(a256, expected, 256)) ok = false;
+        slicedCryptBlocks<u64x4>(cipher, a256, 256, true);
+        if (memcmp(a256, all, 256)) ok = false;
+    }
+    return ok;
+}
+
+// Blocks/s of slicedCrypt alone on data that is already in sliced form,
+// i.e. without the transposes in and out
+template <typename W>
+double slicedCoreRate(const SDES& cipher, size_t blocks) {
+    SlicedSubkeys<W> keys(cipher.subkey1(), cipher.subkey2());
+    W bits[8];
+    for (int j = 0; j < 8; j++) bits[j] = W{} + uint64_t(j + 1) * 0x9E3779B97F4A7C15ULL;
+    size_t rounds = blocks / (64 * Lanes<W>::words);
+    auto start = chrono::steady_clock::now();
+    for (size_t r = 0; r < rounds; r++) slicedCrypt(bits, keys.k1, keys.k2);
+    double t = secondsSince(start);
+    volatile uint64_t sink = Lanes<W>::word(bits[0], 0);
+    (void)sink;
+    return double(rounds) * 64 * Lanes<W>::words / t;
+}
+
+// Random known-plaintext problems: pairs for a random key each
+vector<KnownPairs> makeSearchProblems(size_t count, size_t pairsEach, vector<unsigned>& keys) {
+    unsigned seed = 12345;
+    auto next = [&seed] { seed = seed * 1103515245 + 12345; return seed >> 16; };
+    vector<KnownPairs> problems(count);
+    keys.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        keys[i] = next() % KEY_COUNT;
+        SDES cipher(keys[i]);
+        for (size_t p = 0; p < pairsEach; p++) {
+            uint8_t plain = next() & 255;
+            problems[i].push_back({plain, cipher.encrypt(plain)});
+        }
+    }
+    return problems;
+}
+
+// Check the cached schedule against generateSubkeys, then report keys/s
+// for the exhaustive search: table-driven, bit-sliced, and many searches
+// spread over 1..N threads
+int runKeySearchBenchmark() {
+    const KeySchedule& ks = keySchedule();
+    for (unsigned key = 0; key < KEY_COUNT; key++) {
+        string K1, K2;
+        generateSubkeys(intToBits(key, 10), K1, K2);
+        if (bitsToInt(K1) != ks.k1[key] || bitsToInt(K2) != ks.k2[key]) {
+            cout << "Key schedule mismatch for key " << intToBits(key, 10) << "\n";
+            return 1;
+        }
+    }
+
+    auto start = chrono::steady_clock::now();
+    volatile unsigned sink = 0;
+    for (unsigned key = 0; key < KEY_COUNT; key++) {
+        string K1, K2;
+        generateSubkeys(intToBits(key, 10), K1, K2);
+        sink += K1[0] + K2[7];
+    }
+    double tStrings = secondsSince(start);
+    start = chrono::steady_clock::now();
+    for (unsigned key = 0; key < KEY_COUNT; key++) {
+        uint8_t K1, K2;
+        generateSubkeys(key, K1, K2);
+        sink += K1 + K2;
+    }
+    double tInts = secondsSince(start);
+    cout << "Key schedule for all " << KEY_COUNT << " keys (cache matches generateSubkeys)\n";
+    cout << "  string generateSubkeys : " << tStrings * 1e6 << " us\n";
+    cout << "  integer generateSubkeys: " << tInts * 1e6 << " us\n";
+
+    const size_t trials = 20000;
+    vector<unsigned> keys;
+    vector<KnownPairs> problems = makeSearchProblems(trials, 3, keys);
+    for (size_t i = 0; i < 200; i++) {
+        vector<unsigned> expected = findKeysReference(problems[i]);
+        bool hasKey = false;
+        for (unsigned k : expected) hasKey = hasKey || k == keys[i];
+        if (!hasKey || findKeys<uint64_t>(problems[i]) != expected || findKeys<u64x4>(problems[i]) != expected) {
+            cout << "Key search mismatch for key " << intToBits(keys[i], 10) << "\n";
+            return 1;
+        }
+    }
+    cout << "  search results match the table-driven search\n";
+
+    ChunkPool single(1);
+    double keysTried = double(trials) * KEY_COUNT;
+    size_t matches = 0;
+    start = chrono::steady_clock::now();
+    for (const KnownPairs& pairs : problems) matches += findKeysReference(pairs).size();
+    double tRef = secondsSince(start);
+    start = chrono::steady_clock::now();
+    for (const KnownPairs& pairs : problems) matches += findKeys<uint64_t>(pairs, single).size();
+    double t64 = secondsSince(start);
+    start = chrono::steady_clock::now();
+    for (const KnownPairs& pairs : problems) matches += findKeys<u64x4>(pairs, single).size();
+    double t256 = secondsSince(start);
+
+    cout << "Exhaustive key search, " << trials << " searches x 3 known pairs, 1 thread\n";
+    cout << "  table-driven      : " << keysTried / tRef / 1e6 << " M keys/s\n";
+    cout << "  bit-sliced x64    : " << keysTried / t64 / 1e6 << " M keys/s\n";
+    cout << "  bit-sliced x256   : " << keysTried / t256 / 1e6 << " M keys/s\n";
+
+    // One search at a time split over the shared pool, then whole searches
+    // spread over the pool (each search single-threaded)
+    start = chrono::steady_clock::now();
+    for (size_t i = 0; i < 2000; i++) matches += findKeys<u64x4>(problems[i]).size();
+    double tSplit = secondsSince(start);
+    cout << "  one search over " << ChunkPool::shared().size() << " thread(s): " << 2000.0 * KEY_COUNT / tSplit / 1e6
+         << " M keys/s, " << tSplit / 2000 * 1e6 << " us per search\n";
+
+    double tOne = 0;
+    cout << "Parallel scaling (independent searches)\n";
+    for (unsigned threads : scalingThreadCounts()) {
+        ChunkPool pool(threads);
+        start = chrono::steady_clock::now();
+        pool.run(trials, 256, 1, [&](size_t b, size_t e) {
+            for (size_t i = b; i < e; i++) findKeys<u64x4>(problems[i], single);
+        });
+        double t = secondsSince(start);
+        if (threads == 1) tOne = t;
+        cout << "  " << threads << " thread(s)      : " << keysTried / t / 1e6 << " M keys/s, speedup " << tOne / t << "x\n";
+    }
+    return matches ? 0 : 1;
+}
+
+int runBenchmark() {
+    cout << "Known-answer tests\n";
+    if (!runKnownAnswerTests()) {
+        cout << "Known-answer tests FAILED\n";
+        return 1;
+    }
+    cout << "  bit-sliced results match the table-driven cipher\n";
+
+    SDES cipher("1010000010");
+    vector<uint8_t> blocks(64 << 20);
+    for (size_t i = 0; i < blocks.size(); i++) blocks[i] = uint8_t(i * 131 + 7);
+    double n = double(blocks.size());
+
+    auto start = chrono::steady_clock::now();
+    for (uint8_t& b : blocks) b = cipher.encrypt(b);
+    double tTable = secondsSince(start);
+
+    start = chrono::steady_clock::now();
+    slicedCryptBlocks<uint64_t>(cipher, blocks.data(), blocks.size(), false);
+    double t64 = secondsSince(start);
+
+    start = chrono::steady_clock::now();
+    slicedCryptBlocks<u64x4>(cipher, blocks.data(), blocks.size(), false);
+    double t256 = secondsSince(start);
+
+    cout << "S-DES encryption, " << blocks.size() << " blocks\n";
+    cout << "  table-driven      : " << n / tTable / 1e6 << " M blocks/s\n";
+    cout << "  bit-sliced x64    : " << n / t64 / 1e6 << " M blocks/s\n";
+    cout << "  bit-sliced x256   : " << n / t256 / 1e6 << " M blocks/s\n";
+    cout << "Bit-sliced core only (blocks already sliced)\n";
+    cout << "  x64               : " << slicedCoreRate<uint64_t>(cipher, blocks.size()) / 1e6 << " M blocks/s\n";
+    cout << "  x256              : " << slicedCoreRate<u64x4>(cipher, blocks.size()) / 1e6 << " M blocks/s\n";
+    return runKeySearchBenchmark();
+}
+
+// --crack P:C [P:C ...]: print every key consistent with the known pairs
+int runKeySearch(int argc, char* argv[]) {
+    KnownPairs pairs;
+    for (int i = 2; i < argc; i++) {
+        string arg = argv[i];
+        if (arg.size() != 17 || arg[8] != ':' || !isBinary(arg.substr(0, 8), 8) || !isBinary(arg.substr(9), 8)) {
+            cerr << "Expected <8-bit plaintext>:<8-bit ciphertext>, got " << arg << endl;
+            return 1;
+        }
+        pairs.push_back({uint8_t(bitsToInt(arg.substr(0, 8))), uint8_t(bitsToInt(arg.substr(9)))});
+    }
+
+    auto start = chrono::steady_clock::now();
+    vector<unsigned> keys = findKeys<u64x4>(pairs);
+    double t = secondsSince(start);
+    for (unsigned key : keys) {
+        SDES cipher(key);
+        cout << intToBits(key, 10) << "  (K1 " << intToBits(cipher.subkey1(), 8) << ", K2 "
+             << intToBits(cipher.subkey2(), 8) << ")\n";
+    }
+    cout << keys.size() << " of " << KEY_COUNT << " keys match, searched in " << t * 1e6 << " us ("
+         << KEY_COUNT / t / 1e6 << " M keys/s)" << endl;
+    return keys.empty() ? 1 : 0;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 1) {
+        string mode = argv[1];
+        if (mode == "--bench") return runBenchmark();
+        if (mode == "--crack" && argc > 2) return runKeySearch(argc, argv);
+        if ((mode == "-e" || mode == "-d") && argc == 4 && isBinary(argv[2], 10) && isBinary(argv[3], 8)) {
+            SDES cipher(argv[2]);
+            uint8_t block = bitsToInt(argv[3]);
+            cout << intToBits(mode == "-e" ? cipher.encrypt(block) : cipher.decrypt(block), 8) << endl;
+            return 0;
+        }
+        cerr << "Usage: " << argv[0] << " [-e|-d <10-bit key> <8-bit block> | --crack <P:C>... | --bench]" << endl;
+        return 1;
+    }
+
     string key;
-    
+
     cout << "Enter a 10-bit binary key: ";
     cin >> key;
 
@@ -1,19 +1,24 @@
 //to implement diffie-hallman key exchange algorithm 
 
-#include <cmath>
+#include <cstdint>
 #include <iostream>
+#include "modexp.h"
 
 using namespace std;
 
 // Power function to return value of a ^ b mod P
+// (exact for any P below 2^63, unlike going through pow())
 long long int power(long long int a, long long int b,
                     long long int P)
 {
-    if (b == 1)
-        return a;
+    return (long long int)modexp::powMod(uint64_t(a), uint64_t(b), uint64_t(P));
+}
 
-    else
-        return (((long long int)pow(a, b)) % P);
+// G^b mod P from a table of G's powers built once for the exchange
+// (a few multiplications per call instead of a full exponentiation)
+long long int fixedPower(const modexp::FixedBase &table, long long int b)
+{
+    return (long long int)table.pow(BigInt(b)).low64();
 }
 
 // Driver program
@@ -29,17 +34,20 @@ int main()
     G = 9; // A primitive root for P, G is taken
     cout << "The value of G : " << G << endl;
 
+    // G and P stay the same for every key generated below
+    modexp::FixedBase gTable(modexp::Modulus(BigInt(P)), BigInt(G), 63);
+
     // Alice will choose the private key a
     a = 4; // a is the chosen private key
     cout << "The private key a for Alice : " << a << endl;
 
-    x = power(G, a, P); // gets the generated key
+    x = fixedPower(gTable, a); // gets the generated key
 
     // Bob will choose the private key b
     b = 3; // b is the chosen private key
     cout << "The private key b for Bob : " << b << endl;
 
-    y = power(G, b, P); // gets the generated key
+    y = fixedPower(gTable, b); // gets the generated key
 
     // Generating the secret key after the exchange
     // of keys
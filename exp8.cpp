@@ -1,23 +1,26 @@
 //8.to implement rsa encryption - decryption 
 // C++ Program for implementation of RSA Algorithm
+//
+//   ./exp8 --keygen [BITS]     RSA key from two random primes (default 2048)
+//   ./exp8 --bench [SAMPLES]   prime checks + prime generation latency
 
 #include <iostream>
 #include <cmath>
 #include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include "modexp.h"
+#include "primes.h"
 
 using namespace std;
 
 // Function to compute base^expo mod m
 int power(int base, int expo, int m) {
-    int res = 1;
-    base = base % m;
-    while (expo > 0) {
-        if (expo & 1)
-            res = (res * 1LL * base) % m;
-        base = (base * 1LL * base) % m;
-        expo = expo / 2;
-    }
-    return res;
+    return (int)modexp::powMod(uint64_t(base), uint64_t(expo), uint64_t(m));
 }
 
 // Function to find modular inverse of e modulo phi(n)
@@ -69,7 +72,114 @@ int decrypt(int c, int d, int n) {
     return power(c, d, n);
 }
 
-int main() {
+double secondsSince(chrono::steady_clock::time_point start) {
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+// RSA key with a modulus of `bits` bits from two random primes (e = 65537)
+int runKeygen(int bits) {
+    primes::SystemRandom rng;
+    BigInt e = 65537, p, q, phi;
+    auto start = chrono::steady_clock::now();
+    do {
+        p = primes::randomPrime(bits / 2, rng);
+        q = primes::randomPrime(bits - bits / 2, rng);
+        phi = (p - 1) * (q - 1);
+    } while (p == q || modexp::gcd(e, phi) != 1);
+    BigInt n = p * q, d = modexp::inverse(e, phi);
+    double t = secondsSince(start);
+
+    cout << hex;
+    cout << "p = " << p << "\nq = " << q << "\n";
+    cout << "Public Key (e, n): (" << e << ", " << n << ")\n";
+    cout << "Private Key (d, n): (" << d << ", " << n << ")\n";
+    cout << dec << n.bitLength() << "-bit key generated in " << t << " s\n";
+
+    modexp::Modulus modulus(n);
+    BigInt M = 123;
+    BigInt C = modulus.pow(M, e);
+    BigInt decrypted = modulus.pow(C, d);
+    cout << "Original Message: " << M << "\nEncrypted Message: " << hex << C << dec
+         << "\nDecrypted Message: " << decrypted << endl;
+    return decrypted == M ? 0 : 1;
+}
+
+// Miller-Rabin against a plain sieve below 10^6, against pseudoprimes
+// and known large primes, and on products of two primes
+bool checkPrimes() {
+    primes::SystemRandom rng;
+    const uint32_t limit = 1000000;
+    vector<char> composite(limit);
+    for (uint32_t i = 2; i < limit; i++) {
+        if (!composite[i])
+            for (uint64_t j = uint64_t(i) * i; j < limit; j += i) composite[j] = 1;
+        if (primes::isProbablePrime(BigInt(i), rng) == bool(composite[i])) {
+            cout << "isProbablePrime wrong for " << i << endl;
+            return false;
+        }
+    }
+    // Carmichael numbers and strong pseudoprimes to several bases
+    for (long long n : {561LL, 41041LL, 825265LL, 321197185LL, 3215031751LL, 3825123056546413051LL}) {
+        if (primes::isProbablePrime(BigInt(n), rng)) {
+            cout << "isProbablePrime accepts pseudoprime " << n << endl;
+            return false;
+        }
+    }
+    // Mersenne primes 2^127 - 1, 2^521 - 1, 2^607 - 1; 2^523 - 1 is composite
+    for (int k : {127, 521, 607, 523}) {
+        BigInt m = (BigInt(1) << k) - 1;
+        if (primes::isProbablePrime(m, rng) != (k != 523)) {
+            cout << "isProbablePrime wrong for 2^" << k << " - 1" << endl;
+            return false;
+        }
+    }
+    for (int bits : {64, 256, 512}) {
+        BigInt p = primes::randomPrime(bits, rng), q = primes::randomPrime(bits, rng);
+        if (size_t(bits) != p.bitLength() || !primes::isProbablePrime(p, rng) || primes::isProbablePrime(p * q, rng)) {
+            cout << "randomPrime(" << bits << ") wrong: " << p << endl;
+            return false;
+        }
+    }
+    cout << "Prime checks pass (sieve below 10^6, pseudoprimes, Mersenne numbers)" << endl;
+    return true;
+}
+
+// Latency of randomPrime at RSA/DSA sizes, over `samples` primes each
+int runBenchmark(int samples) {
+    if (!checkPrimes()) return 1;
+    primes::SystemRandom rng;
+    cout << "\nRandom prime generation, " << samples << " samples, "
+         << ChunkPool::shared().size() << " thread(s), ms" << endl;
+    cout << "   bits      p50      p90      p99      max     mean" << endl;
+    for (int bits : {1024, 2048, 3072}) {
+        vector<double> ms;
+        for (int i = 0; i < samples; i++) {
+            auto start = chrono::steady_clock::now();
+            BigInt p = primes::randomPrime(bits, rng);
+            ms.push_back(secondsSince(start) * 1e3);
+            if (p.bitLength() != size_t(bits)) return 1;
+        }
+        sort(ms.begin(), ms.end());
+        auto percentile = [&](double f) { return ms[min(ms.size() - 1, size_t(f * ms.size()))]; };
+        double mean = 0;
+        for (double v : ms) mean += v / ms.size();
+        cout << setw(7) << bits << fixed << setprecision(1) << setw(9) << percentile(0.5) << setw(9)
+             << percentile(0.9) << setw(9) << percentile(0.99) << setw(9) << ms.back() << setw(9) << mean
+             << defaultfloat << setprecision(6) << endl;
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 1) {
+        string mode = argv[1];
+        int value = argc > 2 ? atoi(argv[2]) : 0;
+        if (mode == "--keygen" && (argc == 2 || value >= 64)) return runKeygen(value ? value : 2048);
+        if (mode == "--bench") return runBenchmark(value > 0 ? value : 10);
+        cerr << "Usage: " << argv[0] << " [--keygen [BITS >= 64] | --bench [SAMPLES]]" << endl;
+        return 1;
+    }
+
     int e, d, n;
     
     // Key Generation
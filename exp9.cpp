@@ -1,4 +1,13 @@
 //9.write a program to generate SHA-1 hash
+//
+//   ./exp9 [FILE|DIR]...          sha1sum-style digests (directories recursively)
+//   ./exp9 -c CHECKFILE...        verify a sha1sum checksum list
+//   ./exp9 --tree FILE [TREEFILE [LEAF_KIB]]            parallel tree hash
+//   ./exp9 --tree-verify FILE TREEFILE [OFFSET:LENGTH]  check against a tree
+//   ./exp9 --tree-update FILE TREEFILE OFFSET:LENGTH... re-hash changed ranges
+//   ./exp9 --resume STATEFILE FILE|-[:OFFSET] [CHECKPOINT_MIB]  restartable hash
+//   ./exp9 --pbkdf2 PASSWORD SALT ITERATIONS [DKLEN]    PBKDF2-HMAC-SHA1 key
+//   ./exp9 --bench [MiB]          test vectors + hashing throughput
 #include <iostream>
 #include <sstream>
 #include <iomanip>
@@ -6,7 +15,736 @@
 #include <cstring>
 #include <fstream>
 #include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <utility>
+#include <array>
+#include <cerrno>
+#include <cctype>
+#include <filesystem>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifndef _WIN32
+#define SHA1_MMAP 1
+#include <sys/mman.h>
+#endif
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+#include "parallel_chunks.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SHA1_X86 1
+#include <cpuid.h>
+#include <immintrin.h>
+#include <x86intrin.h>
+#endif
+
+// SHA-1 compression functions. Each one hashes `blocks` consecutive 64-byte
+// blocks into state[5]; SHA1 picks the fastest the CPU supports at runtime.
+namespace sha1kernel {
+
+enum Backend { Scalar, SSSE3, SHANI };
+
+typedef void (*CompressFn)(uint32_t state[5], const uint8_t *data, size_t blocks);
+
+inline const char *backendName(Backend b) {
+    return b == SHANI ? "sha-ni" : b == SSSE3 ? "ssse3" : "scalar";
+}
+
+// Word helpers are templates so the multi-buffer code can run them on
+// vectors of words from several messages; always_inline lets them be pulled
+// into the AVX2/AVX-512 functions below without a target mismatch. They
+// return words through out-parameters, never by value, so no function's ABI
+// depends on whether -mavx or -mavx512f is given.
+template <int N, typename T>
+__attribute__((always_inline)) inline void rol(T &out, const T &x) {
+    out = (x << N) | (x >> (32 - N));
+}
+
+inline uint32_t loadBigEndian(const uint8_t *p) {
+    return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | p[3];
+}
+
+inline void storeBigEndian(uint8_t *p, uint32_t v) {
+    p[0] = uint8_t(v >> 24);
+    p[1] = uint8_t(v >> 16);
+    p[2] = uint8_t(v >> 8);
+    p[3] = uint8_t(v);
+}
+
+template <int I>
+constexpr uint32_t roundConstant() {
+    return I < 20 ? 0x5A827999 : I < 40 ? 0x6ED9EBA1 : I < 60 ? 0x8F1BBCDC : 0xCA62C1D6;
+}
+
+// Round I with wk = W[I] + K. Instead of moving a..e along, the registers
+// stay put and each round names them at a rotating offset, so the whole
+// 80-round sequence compiles to straight-line code with no moves or branches.
+template <int I, typename T>
+__attribute__((always_inline)) inline void round(T v[5], const T &wk) {
+    T &a = v[(100 - I) % 5], &b = v[(101 - I) % 5], &c = v[(102 - I) % 5];
+    T &d = v[(103 - I) % 5], &e = v[(104 - I) % 5];
+    T f;
+    if (I < 20) f = d ^ (b & (c ^ d));
+    else if (I < 40 || I >= 60) f = b ^ c ^ d;
+    else f = (b & c) | (d & (b | c));
+    T a5;
+    rol<5>(a5, a);
+    e += a5 + f + wk;
+    rol<30>(b, b);
+}
+
+// W[I], left in w[I & 15] of a 16-word ring, expanded in place from round
+// 16 on
+template <int I, typename T>
+__attribute__((always_inline)) inline void scheduleWord(T w[16]) {
+    if (I >= 16) rol<1>(w[I & 15], w[(I + 13) & 15] ^ w[(I + 8) & 15] ^ w[(I + 2) & 15] ^ w[I & 15]);
+}
+
+template <typename T, size_t... I>
+__attribute__((always_inline)) inline void scalarRounds(T v[5], T w[16], std::index_sequence<I...>) {
+    ((scheduleWord<I>(w), round<I>(v, w[I & 15] + roundConstant<I>())), ...);
+}
+
+inline void compressScalar(uint32_t state[5], const uint8_t *data, size_t blocks) {
+    for (; blocks > 0; --blocks, data += 64) {
+        uint32_t w[16];
+        for (int i = 0; i < 16; ++i) w[i] = loadBigEndian(data + 4 * i);
+        uint32_t v[5] = {state[0], state[1], state[2], state[3], state[4]};
+        scalarRounds(v, w, std::make_index_sequence<80>());
+        for (int i = 0; i < 5; ++i) state[i] += v[i];
+    }
+}
+
+#ifdef SHA1_X86
+template <size_t... I>
+inline void precomputedRounds(uint32_t v[5], const uint32_t wk[80], std::index_sequence<I...>) {
+    (round<I>(v, wk[I]), ...);
+}
+
+// The message schedule four words at a time: W[i..i+3] from the three
+// vectors before it. Lane 3 needs W[i] itself, so it is computed without it
+// first and patched with rol(W[i], 1) afterwards. W + K goes to wk[] and
+// the rounds themselves stay scalar.
+__attribute__((target("ssse3")))
+inline void compressSSSE3(uint32_t state[5], const uint8_t *data, size_t blocks) {
+    const __m128i byteSwap = _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+    alignas(16) uint32_t wk[80];
+    for (; blocks > 0; --blocks, data += 64) {
+        __m128i w[20];
+        for (int i = 0; i < 4; ++i)
+            w[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 16 * i)), byteSwap);
+        for (int i = 4; i < 20; ++i) {
+            __m128i x = _mm_xor_si128(_mm_srli_si128(w[i - 1], 4), w[i - 2]);
+            x = _mm_xor_si128(x, _mm_alignr_epi8(w[i - 3], w[i - 4], 8));
+            x = _mm_xor_si128(x, w[i - 4]);
+            x = _mm_or_si128(_mm_slli_epi32(x, 1), _mm_srli_epi32(x, 31));
+            __m128i first = _mm_slli_si128(x, 12);
+            x = _mm_xor_si128(x, _mm_or_si128(_mm_slli_epi32(first, 1), _mm_srli_epi32(first, 31)));
+            w[i] = x;
+        }
+        for (int i = 0; i < 20; ++i) {
+            __m128i k = _mm_set1_epi32(i < 5 ? 0x5A827999 : i < 10 ? 0x6ED9EBA1 : i < 15 ? 0x8F1BBCDC : 0xCA62C1D6);
+            _mm_store_si128((__m128i *)(wk + 4 * i), _mm_add_epi32(w[i], k));
+        }
+        uint32_t v[5] = {state[0], state[1], state[2], state[3], state[4]};
+        precomputedRounds(v, wk, std::make_index_sequence<80>());
+        for (int i = 0; i < 5; ++i) state[i] += v[i];
+    }
+}
+
+// One group of four rounds with the SHA extensions. msg[] holds the four
+// message vectors in flight and e[] the two E values that alternate; after
+// inlining every index is a constant.
+template <int G>
+__attribute__((target("sha,ssse3,sse4.1")))
+inline void shaniGroup(__m128i &abcd, __m128i e[2], __m128i msg[4], const uint8_t *data, __m128i byteSwap) {
+    const int m = G % 4;
+    if (G < 4)
+        msg[m] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 16 * G)), byteSwap);
+    if (G == 0) e[0] = _mm_add_epi32(e[0], msg[0]);
+    else e[G % 2] = _mm_sha1nexte_epu32(e[G % 2], msg[m]);
+    e[1 - G % 2] = abcd;
+    if (G >= 3 && G <= 18) msg[(G + 1) % 4] = _mm_sha1msg2_epu32(msg[(G + 1) % 4], msg[m]);
+    abcd = _mm_sha1rnds4_epu32(abcd, e[G % 2], G / 5);
+    if (G >= 1 && G <= 16) msg[(G + 3) % 4] = _mm_sha1msg1_epu32(msg[(G + 3) % 4], msg[m]);
+    if (G >= 2 && G <= 17) msg[(G + 2) % 4] = _mm_xor_si128(msg[(G + 2) % 4], msg[m]);
+}
+
+template <size_t... G>
+__attribute__((target("sha,ssse3,sse4.1")))
+inline void shaniGroups(__m128i &abcd, __m128i e[2], __m128i msg[4], const uint8_t *data, __m128i byteSwap,
+                        std::index_sequence<G...>) {
+    (shaniGroup<G>(abcd, e, msg, data, byteSwap), ...);
+}
+
+__attribute__((target("sha,ssse3,sse4.1")))
+inline void compressSHANI(uint32_t state[5], const uint8_t *data, size_t blocks) {
+    const __m128i byteSwap = _mm_set_epi64x(0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL);
+    __m128i abcd = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)state), 0x1B);
+    __m128i e0 = _mm_set_epi32(state[4], 0, 0, 0);
+    for (; blocks > 0; --blocks, data += 64) {
+        __m128i abcdSave = abcd, e0Save = e0;
+        __m128i e[2] = {e0, e0}, msg[4];
+        shaniGroups(abcd, e, msg, data, byteSwap, std::make_index_sequence<20>());
+        e0 = _mm_sha1nexte_epu32(e[0], e0Save);
+        abcd = _mm_add_epi32(abcd, abcdSave);
+    }
+    _mm_storeu_si128((__m128i *)state, _mm_shuffle_epi32(abcd, 0x1B));
+    state[4] = _mm_extract_epi32(e0, 3);
+}
+#endif
+
+// SHA-NI is CPUID leaf 7, EBX bit 29; the kernel also uses SSSE3/SSE4.1
+inline bool supported(Backend b) {
+#ifdef SHA1_X86
+    if (b == SSSE3) return __builtin_cpu_supports("ssse3");
+    if (b == SHANI) {
+        unsigned eax, ebx, ecx, edx;
+        if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) return false;
+        return (ebx >> 29 & 1) && __builtin_cpu_supports("ssse3") && __builtin_cpu_supports("sse4.1");
+    }
+#endif
+    return b == Scalar;
+}
+
+inline Backend best() {
+    static const Backend chosen = supported(SHANI) ? SHANI : supported(SSSE3) ? SSSE3 : Scalar;
+    return chosen;
+}
+
+inline CompressFn compressFunction(Backend b) {
+#ifdef SHA1_X86
+    if (b == SHANI) return compressSHANI;
+    if (b == SSSE3) return compressSSSE3;
+#endif
+    (void)b;
+    return compressScalar;
+}
+
+// Multi-buffer hashing: L independent messages share one compression, each
+// in its own lane of a vector of words. GCC vector extensions give 4 lanes
+// in SSE/NEON registers, 8 in AVX2 and 16 in AVX-512 ones.
+typedef uint32_t u32x4 __attribute__((vector_size(16)));
+typedef uint32_t u32x8 __attribute__((vector_size(32)));
+typedef uint32_t u32x16 __attribute__((vector_size(64)));
+
+const uint32_t INITIAL_STATE[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+
+// A message being fed through a lane. Its padded blocks come straight from
+// the data, except the last one or two, which are built in pad[].
+struct LaneMessage {
+    const uint8_t *data;
+    size_t len, block, blocks;
+    uint8_t pad[128];
+
+    void start(const uint8_t *d, size_t n) {
+        data = d;
+        len = n;
+        block = 0;
+        blocks = (n + 8) / 64 + 1;
+        size_t whole = n / 64;
+        std::memset(pad, 0, sizeof(pad));
+        if (n % 64) std::memcpy(pad, d + whole * 64, n % 64); // d may be null when n is 0
+        pad[n % 64] = 0x80;
+        size_t padLen = (blocks - whole) * 64;
+        for (int i = 0; i < 8; ++i) pad[padLen - 1 - i] = (uint64_t(n) * 8) >> (i * 8);
+    }
+
+    const uint8_t *next() {
+        const uint8_t *p = block < len / 64 ? data + block * 64 : pad + (block - len / 64) * 64;
+        ++block;
+        return p;
+    }
+};
+
+// Hash messages [0, count) L at a time. A lane whose message is done writes
+// its digest and takes the next waiting message, so lanes stay busy when
+// lengths differ; lanes with nothing left hash a dummy block.
+template <typename V, int L>
+__attribute__((always_inline)) inline void hashLanes(const uint8_t *const *data, const size_t *len, size_t count,
+                                                     std::array<uint8_t, 20> *digest) {
+    static const uint8_t idle[64] = {};
+    LaneMessage lane[L];
+    size_t owner[L];
+    uint32_t initial[5][L];
+    size_t next = 0, busy = 0;
+    for (int l = 0; l < L; ++l) {
+        owner[l] = count;
+        if (next < count) {
+            owner[l] = next;
+            lane[l].start(data[next], len[next]);
+            ++next;
+            ++busy;
+        }
+        for (int j = 0; j < 5; ++j) initial[j][l] = INITIAL_STATE[j];
+    }
+    V state[5];
+    std::memcpy(state, initial, sizeof(state));
+
+    while (busy > 0) {
+        alignas(64) uint32_t words[16][L];
+        for (int l = 0; l < L; ++l) {
+            const uint8_t *block = owner[l] < count ? lane[l].next() : idle;
+            for (int i = 0; i < 16; ++i) words[i][l] = loadBigEndian(block + 4 * i);
+        }
+        V w[16], v[5];
+        std::memcpy(w, words, sizeof(w));
+        for (int j = 0; j < 5; ++j) v[j] = state[j];
+        scalarRounds(v, w, std::make_index_sequence<80>());
+        for (int j = 0; j < 5; ++j) state[j] += v[j];
+
+        for (int l = 0; l < L; ++l) {
+            if (owner[l] >= count || lane[l].block < lane[l].blocks) continue;
+            for (int j = 0; j < 5; ++j) {
+                uint32_t h = state[j][l];
+                digest[owner[l]][4 * j + 0] = h >> 24;
+                digest[owner[l]][4 * j + 1] = h >> 16;
+                digest[owner[l]][4 * j + 2] = h >> 8;
+                digest[owner[l]][4 * j + 3] = h;
+                state[j][l] = INITIAL_STATE[j];
+            }
+            owner[l] = count;
+            --busy;
+            if (next < count) {
+                owner[l] = next;
+                lane[l].start(data[next], len[next]);
+                ++next;
+                ++busy;
+            }
+        }
+    }
+}
+
+inline void hashLanes4(const uint8_t *const *data, const size_t *len, size_t count, std::array<uint8_t, 20> *digest) {
+    hashLanes<u32x4, 4>(data, len, count, digest);
+}
+
+#ifdef SHA1_X86
+__attribute__((target("avx2")))
+#endif
+inline void hashLanes8(const uint8_t *const *data, const size_t *len, size_t count, std::array<uint8_t, 20> *digest) {
+    hashLanes<u32x8, 8>(data, len, count, digest);
+}
+
+#ifdef SHA1_X86
+__attribute__((target("avx512f")))
+#endif
+inline void hashLanes16(const uint8_t *const *data, const size_t *len, size_t count, std::array<uint8_t, 20> *digest) {
+    hashLanes<u32x16, 16>(data, len, count, digest);
+}
+
+// x = SHA-1 compression of the 20-byte message x (as words) from the
+// chaining state key. A 20-byte HMAC message after its 64-byte key block
+// always has the same padding: 0x80, zeros, then 84 * 8 bits.
+template <typename V>
+__attribute__((always_inline)) inline void hashDigestBlock(V x[5], const V key[5]) {
+    V w[16] = {x[0], x[1], x[2], x[3], x[4], V{} + 0x80000000u};
+    w[15] = V{} + uint32_t(84 * 8);
+    V v[5] = {key[0], key[1], key[2], key[3], key[4]};
+    scalarRounds(v, w, std::make_index_sequence<80>());
+    for (int j = 0; j < 5; ++j) x[j] = key[j] + v[j];
+}
+
+// PBKDF2-HMAC-SHA1 iterations 2..c for L passwords in lockstep. inner,
+// outer, u and t are 5 x L words (word j of lane l at j * L + l): the
+// HMAC key states, U_1 on entry and U_1 ^ ... ^ U_c on return.
+template <typename V, int L>
+__attribute__((always_inline)) inline void pbkdf2Lanes(const uint32_t *inner, const uint32_t *outer,
+                                                       const uint32_t *u, uint32_t iterations, uint32_t *t) {
+    V in[5], out[5], x[5], acc[5];
+    std::memcpy(in, inner, sizeof(in));
+    std::memcpy(out, outer, sizeof(out));
+    std::memcpy(x, u, sizeof(x));
+    std::memcpy(acc, u, sizeof(acc));
+    for (uint32_t i = 1; i < iterations; ++i) {
+        hashDigestBlock(x, in);
+        hashDigestBlock(x, out);
+        for (int j = 0; j < 5; ++j) acc[j] ^= x[j];
+    }
+    std::memcpy(t, acc, sizeof(acc));
+}
+
+inline void pbkdf2Lanes4(const uint32_t *inner, const uint32_t *outer, const uint32_t *u, uint32_t c, uint32_t *t) {
+    pbkdf2Lanes<u32x4, 4>(inner, outer, u, c, t);
+}
+
+#ifdef SHA1_X86
+__attribute__((target("avx2")))
+#endif
+inline void pbkdf2Lanes8(const uint32_t *inner, const uint32_t *outer, const uint32_t *u, uint32_t c, uint32_t *t) {
+    pbkdf2Lanes<u32x8, 8>(inner, outer, u, c, t);
+}
+
+#ifdef SHA1_X86
+__attribute__((target("avx512f")))
+#endif
+inline void pbkdf2Lanes16(const uint32_t *inner, const uint32_t *outer, const uint32_t *u, uint32_t c, uint32_t *t) {
+    pbkdf2Lanes<u32x16, 16>(inner, outer, u, c, t);
+}
+
+// Lane counts: 4 everywhere; 8 and 16 need AVX2 / AVX-512 on x86
+inline bool lanesSupported(int lanes) {
+#ifdef SHA1_X86
+    if (lanes == 16) return __builtin_cpu_supports("avx512f");
+    if (lanes == 8) return __builtin_cpu_supports("avx2");
+#endif
+    return lanes == 4;
+}
+
+inline int bestLanes() {
+    static const int chosen = lanesSupported(16) ? 16 : lanesSupported(8) ? 8 : 4;
+    return chosen;
+}
+
+} // namespace sha1kernel
+
+// Hex digits for every byte value, two characters per entry
+struct HexTable {
+    char pair[256][2];
+    unsigned char value[256]; // digit value, 0xFF if not a hex digit
+
+    constexpr HexTable() : pair(), value() {
+        const char digits[] = "0123456789abcdef";
+        for (int i = 0; i < 256; ++i) {
+            pair[i][0] = digits[i >> 4];
+            pair[i][1] = digits[i & 15];
+            value[i] = i >= '0' && i <= '9' ? i - '0' : i >= 'a' && i <= 'f' ? i - 'a' + 10
+                     : i >= 'A' && i <= 'F' ? i - 'A' + 10 : 0xFF;
+        }
+    }
+};
+
+constexpr HexTable HEX_TABLE;
+
+// Lower-case hex of in[0, len) into out[0, 2 * len)
+inline void encodeHex(const unsigned char *in, size_t len, char *out) {
+    for (size_t i = 0; i < len; ++i) {
+        out[2 * i] = HEX_TABLE.pair[in[i]][0];
+        out[2 * i + 1] = HEX_TABLE.pair[in[i]][1];
+    }
+}
+
+// 2 * len hex digits (either case) into len bytes; false on any other character
+inline bool decodeHex(const char *in, size_t len, unsigned char *out) {
+    unsigned char bad = 0;
+    for (size_t i = 0; i < len; ++i) {
+        unsigned char hi = HEX_TABLE.value[(unsigned char)in[2 * i]];
+        unsigned char lo = HEX_TABLE.value[(unsigned char)in[2 * i + 1]];
+        bad |= hi | lo;
+        out[i] = (unsigned char)(hi << 4 | (lo & 15));
+    }
+    return !(bad & 0xF0);
+}
+
+// Compare two digests in time that does not depend on where they differ
+inline bool digestsEqual(const unsigned char *a, const unsigned char *b, size_t len = 20) {
+    unsigned char diff = 0;
+    for (size_t i = 0; i < len; ++i) diff |= a[i] ^ b[i];
+    return diff == 0;
+}
 
+class SHA1 {
+public:
+    SHA1() : compress(sha1kernel::compressFunction(sha1kernel::best())) { reset(); }
+
+    // Force one compression backend (it must be supported on this CPU)
+    explicit SHA1(sha1kernel::Backend backend) : compress(sha1kernel::compressFunction(backend)) { reset(); }
+
+    void update(const std::string &s) {
+        update(reinterpret_cast<const unsigned char*>(s.c_str()), s.size());
+    }
+
+    // Whole 64-byte blocks are compressed straight from data; only a
+    // partial block at the end is copied into the tail buffer
+    void update(const unsigned char *data, size_t len) {
+        if (len == 0) return; // data may be null; memcpy must not see it
+        bit_len += uint64_t(len) * 8;
+        if (tail_len > 0) {
+            size_t take = std::min(len, 64 - tail_len);
+            std::memcpy(tail + tail_len, data, take);
+            tail_len += take;
+            data += take;
+            len -= take;
+            if (tail_len < 64) return;
+            compress(h, tail, 1);
+            tail_len = 0;
+        }
+        compress(h, data, len / 64);
+        data += len / 64 * 64;
+        len %= 64;
+        std::memcpy(tail, data, len);
+        tail_len = len;
+    }
+
+    // Raw 20-byte digest
+    void final(unsigned char digest[20]) {
+        finalize(digest);
+    }
+
+    std::string final() {
+        unsigned char digest[20];
+        finalize(digest);
+
+        std::string hex(40, '0');
+        encodeHex(digest, 20, &hex[0]);
+        return hex;
+    }
+
+    void reset() {
+        h[0] = 0x67452301;
+        h[1] = 0xEFCDAB89;
+        h[2] = 0x98BADCFE;
+        h[3] = 0x10325476;
+        h[4] = 0xC3D2E1F0;
+        tail_len = 0;
+        bit_len = 0;
+        finalized = false;
+    }
+
+    // A copy that continues from everything absorbed so far: hash a shared
+    // prefix once, then snapshot() per suffix. Copying is a plain ~100-byte
+    // copy with no allocation.
+    SHA1 snapshot() const { return *this; }
+
+    uint64_t bytesHashed() const { return bit_len / 8; }
+
+    // The chaining value h[0..4]. It is the whole state only at a block
+    // boundary, e.g. right after an HMAC key block.
+    void chainingState(uint32_t state[5]) const { std::memcpy(state, h, sizeof(h)); }
+
+    // Serialized state: "SHA1ST01", h[0..4] and the byte count big-endian,
+    // then the tail length and all 64 tail bytes. Independent of the
+    // backend and the machine, so a hash can be resumed in another process.
+    static const size_t STATE_SIZE = 8 + 20 + 8 + 1 + 64;
+
+    // False once the digest has been taken (the state is padded by then)
+    bool saveState(unsigned char out[STATE_SIZE]) const {
+        if (finalized) return false;
+        std::memcpy(out, "SHA1ST01", 8);
+        for (int i = 0; i < 5; ++i) storeBigEndian(out + 8 + 4 * i, h[i], 4);
+        storeBigEndian(out + 28, bit_len / 8, 8);
+        out[36] = (unsigned char)tail_len;
+        std::memset(out + 37, 0, 64);
+        std::memcpy(out + 37, tail, tail_len);
+        return true;
+    }
+
+    // Load a state written by saveState; on malformed input returns false
+    // and leaves this object unchanged
+    bool restoreState(const unsigned char *in, size_t len) {
+        if (len != STATE_SIZE || std::memcmp(in, "SHA1ST01", 8) != 0) return false;
+        uint64_t bytes = loadBigEndian(in + 28, 8);
+        if (in[36] != bytes % 64 || bytes >> 61) return false;
+        for (int i = 0; i < 5; ++i) h[i] = uint32_t(loadBigEndian(in + 8 + 4 * i, 4));
+        bit_len = bytes * 8;
+        tail_len = in[36];
+        std::memcpy(tail, in + 37, tail_len);
+        finalized = false;
+        return true;
+    }
+
+private:
+    sha1kernel::CompressFn compress;
+    uint32_t h[5];
+    uint8_t tail[64];       // bytes of a block that is not complete yet
+    size_t tail_len = 0;
+    uint64_t bit_len = 0;
+    bool finalized = false;
+
+    static void storeBigEndian(unsigned char *p, uint64_t v, int bytes) {
+        for (int i = 0; i < bytes; ++i) p[i] = (unsigned char)(v >> (8 * (bytes - 1 - i)));
+    }
+
+    static uint64_t loadBigEndian(const unsigned char *p, int bytes) {
+        uint64_t v = 0;
+        for (int i = 0; i < bytes; ++i) v = v << 8 | p[i];
+        return v;
+    }
+
+    void finalize(unsigned char digest[20]) {
+        if (finalized) return;
+        finalized = true;
+
+        // 0x80, zeros up to 56 mod 64, then the length: one or two blocks
+        uint8_t pad[128] = {};
+        std::memcpy(pad, tail, tail_len);
+        pad[tail_len] = 0x80;
+        size_t pad_len = tail_len < 56 ? 64 : 128;
+        for (int i = 0; i < 8; ++i)
+            pad[pad_len - 1 - i] = (bit_len >> (i * 8)) & 0xFF;
+
+        compress(h, pad, pad_len / 64);
+
+        for (int i = 0; i < 5; ++i) {
+            digest[i * 4 + 0] = (h[i] >> 24) & 0xFF;
+            digest[i * 4 + 1] = (h[i] >> 16) & 0xFF;
+            digest[i * 4 + 2] = (h[i] >> 8) & 0xFF;
+            digest[i * 4 + 3] = h[i] & 0xFF;
+        }
+    }
+};
+
+// Hash count independent messages (data[i], len[i]) into raw 20-byte
+// digests, several at a time in SIMD lanes. lanes is 4, 8 or 16, or 0 for
+// the widest this CPU supports.
+void hashMany(const unsigned char *const *data, const size_t *len, size_t count,
+              std::array<unsigned char, 20> *digest, int lanes = 0) {
+    if (lanes == 0) lanes = sha1kernel::bestLanes();
+    if (lanes == 16) sha1kernel::hashLanes16(data, len, count, digest);
+    else if (lanes == 8) sha1kernel::hashLanes8(data, len, count, digest);
+    else sha1kernel::hashLanes4(data, len, count, digest);
+}
+
+// HMAC-SHA1 (RFC 2104). The key blocks, key ^ ipad and key ^ opad, are
+// absorbed once in the constructor; every message then starts from a
+// snapshot of those two states instead of hashing 128 key bytes again.
+class HmacSHA1 {
+public:
+    HmacSHA1(const unsigned char *key, size_t len) {
+        unsigned char block[64] = {};
+        if (len > 64) {
+            SHA1 sha;
+            sha.update(key, len);
+            sha.final(block);
+        } else {
+            std::memcpy(block, key, len);
+        }
+        for (unsigned char &b : block) b ^= 0x36;
+        inner.update(block, 64);
+        for (unsigned char &b : block) b ^= 0x36 ^ 0x5c;
+        outer.update(block, 64);
+    }
+
+    explicit HmacSHA1(const std::string &key)
+        : HmacSHA1(reinterpret_cast<const unsigned char*>(key.data()), key.size()) {}
+
+    // For messages fed in pieces: update the context from begin(), then
+    // finish() it
+    SHA1 begin() const { return inner.snapshot(); }
+
+    void finish(SHA1 &ctx, unsigned char mac[20]) const {
+        unsigned char digest[20];
+        ctx.final(digest);
+        SHA1 o = outer.snapshot();
+        o.update(digest, 20);
+        o.final(mac);
+    }
+
+    void mac(const unsigned char *msg, size_t len, unsigned char out[20]) const {
+        SHA1 ctx = begin();
+        ctx.update(msg, len);
+        finish(ctx, out);
+    }
+
+    std::string mac(const std::string &msg) const {
+        unsigned char out[20];
+        mac(reinterpret_cast<const unsigned char*>(msg.data()), msg.size(), out);
+        std::string hex(40, '0');
+        encodeHex(out, 20, &hex[0]);
+        return hex;
+    }
+
+    // Chaining values after the inner and outer key blocks
+    void keyStates(uint32_t in[5], uint32_t out[5]) const {
+        inner.chainingState(in);
+        outer.chainingState(out);
+    }
+
+private:
+    SHA1 inner, outer;
+};
+
+// U_1 = HMAC(P, salt || INT(block)) for PBKDF2 block number `block`
+inline void pbkdf2First(const HmacSHA1 &hmac, const unsigned char *salt, size_t saltLen, uint32_t block,
+                        unsigned char u[20]) {
+    unsigned char index[4];
+    sha1kernel::storeBigEndian(index, block);
+    SHA1 ctx = hmac.begin();
+    ctx.update(salt, saltLen);
+    ctx.update(index, 4);
+    hmac.finish(ctx, u);
+}
+
+// PBKDF2-HMAC-SHA1 (RFC 8018) into out[0, outLen). After U_1 every
+// iteration is exactly two compressions: U is written into pre-padded
+// inner and outer blocks, which are compressed from the saved key states,
+// with no SHA1 objects, padding or buffering in the loop.
+void pbkdf2HmacSha1(const unsigned char *password, size_t passwordLen, const unsigned char *salt, size_t saltLen,
+                    uint32_t iterations, unsigned char *out, size_t outLen) {
+    HmacSHA1 hmac(password, passwordLen);
+    uint32_t inner[5], outer[5];
+    hmac.keyStates(inner, outer);
+    sha1kernel::CompressFn compress = sha1kernel::compressFunction(sha1kernel::best());
+
+    // 20 bytes of U, 0x80, zeros and the bit length of 64 + 20 bytes
+    uint8_t innerBlock[64] = {}, outerBlock[64] = {};
+    innerBlock[20] = outerBlock[20] = 0x80;
+    sha1kernel::storeBigEndian(innerBlock + 60, 84 * 8);
+    sha1kernel::storeBigEndian(outerBlock + 60, 84 * 8);
+
+    for (uint32_t block = 1; outLen > 0; ++block) {
+        pbkdf2First(hmac, salt, saltLen, block, innerBlock);
+        uint32_t t[5];
+        for (int j = 0; j < 5; ++j) t[j] = sha1kernel::loadBigEndian(innerBlock + 4 * j);
+        for (uint32_t i = 1; i < iterations; ++i) {
+            uint32_t s[5] = {inner[0], inner[1], inner[2], inner[3], inner[4]};
+            compress(s, innerBlock, 1);
+            for (int j = 0; j < 5; ++j) sha1kernel::storeBigEndian(outerBlock + 4 * j, s[j]);
+            for (int j = 0; j < 5; ++j) s[j] = outer[j];
+            compress(s, outerBlock, 1);
+            for (int j = 0; j < 5; ++j) {
+                sha1kernel::storeBigEndian(innerBlock + 4 * j, s[j]);
+                t[j] ^= s[j];
+            }
+        }
+        unsigned char derived[20];
+        for (int j = 0; j < 5; ++j) sha1kernel::storeBigEndian(derived + 4 * j, t[j]);
+        size_t take = std::min<size_t>(outLen, 20);
+        std::memcpy(out, derived, take);
+        out += take;
+        outLen -= take;
+    }
+}
+
+// One 20-byte PBKDF2-HMAC-SHA1 key (dkLen <= 20 takes a prefix) for each
+// of count passwords under one salt and iteration count. The iterations
+// run `lanes` passwords at a time in SIMD lanes (4, 8 or 16, or 0 for the
+// widest this CPU supports); only U_1 is computed per password.
+void pbkdf2HmacSha1Many(const std::string *passwords, size_t count, const unsigned char *salt, size_t saltLen,
+                        uint32_t iterations, std::array<unsigned char, 20> *out, int lanes = 0) {
+    if (lanes == 0) lanes = sha1kernel::bestLanes();
+    for (size_t first = 0; first < count; first += lanes) {
+        alignas(64) uint32_t inner[5 * 16], outer[5 * 16], u[5 * 16], t[5 * 16];
+        for (int l = 0; l < lanes; ++l) {
+            // Spare lanes in the last group repeat the first password
+            const std::string &pw = passwords[first + l < count ? first + l : first];
+            HmacSHA1 hmac(pw);
+            uint32_t in[5], ou[5];
+            unsigned char u1[20];
+            hmac.keyStates(in, ou);
+            pbkdf2First(hmac, salt, saltLen, 1, u1);
+            for (int j = 0; j < 5; ++j) {
+                inner[j * lanes + l] = in[j];
+                outer[j * lanes + l] = ou[j];
+                u[j * lanes + l] = sha1kernel::loadBigEndian(u1 + 4 * j);
+            }
+        }
+        if (lanes == 16) sha1kernel::pbkdf2Lanes16(inner, outer, u, iterations, t);
+        else if (lanes == 8) sha1kernel::pbkdf2Lanes8(inner, outer, u, iterations, t);
+        else sha1kernel::pbkdf2Lanes4(inner, outer, u, iterations, t);
+        for (int l = 0; l < lanes && first + l < count; ++l)
+            for (int j = 0; j < 5; ++j) sha1kernel::storeBigEndian(out[first + l].data() + 4 * j, t[j * lanes + l]);
+    }
+}
+
+namespace reference {
+
+// The original byte-at-a-time SHA-1, kept for the --bench comparison
 class SHA1 {
 public:
     SHA1() { reset(); }
@@ -36,6 +774,17 @@ public:
         finalized = false;
     }
 
+    void update(const unsigned char *data, size_t len) {
+        bit_len += len * 8;
+        for (size_t i = 0; i < len; ++i) {
+            buffer.push_back(data[i]);
+            if (buffer.size() == 64) {
+                process_block(buffer.data());
+                buffer.clear();
+            }
+        }
+    }
+
 private:
     uint32_t h0, h1, h2, h3, h4;
     std::vector<unsigned char> buffer;
@@ -83,17 +832,6 @@ private:
         h4 += e;
     }
 
-    void update(const unsigned char *data, size_t len) {
-        bit_len += len * 8;
-        for (size_t i = 0; i < len; ++i) {
-            buffer.push_back(data[i]);
-            if (buffer.size() == 64) {
-                process_block(buffer.data());
-                buffer.clear();
-            }
-        }
-    }
-
     void finalize(unsigned char digest[20]) {
         if (finalized) return;
         finalized = true;
@@ -121,6 +859,7 @@ private:
     }
 };
 
+// The original helpers, formatting and comparing through strings
 std::string hashString(const std::string& input) {
     SHA1 sha;
     sha.update(input);
@@ -139,8 +878,1223 @@ bool verifyHash(const std::string& input, const std::string& target_hash) {
     return computed == target;
 }
 
+} // namespace reference
+
+std::string hashString(const std::string& input) {
+    SHA1 sha;
+    sha.update(input);
+    return sha.final();
+}
+
+void toLowerCase(std::string& str) {
+    std::transform(str.begin(), str.end(), str.begin(), ::tolower);
+}
+
+// Parse a hex digest (either case) into raw bytes; false if it is not
+// exactly 40 hex digits
+bool parseDigest(const std::string& hex, unsigned char digest[20]) {
+    return hex.size() == 40 && decodeHex(hex.data(), 20, digest);
+}
+
+// Hash input and compare the raw digest with the parsed target in constant
+// time, without building or lower-casing any strings
+bool verifyHash(const std::string& input, const std::string& target_hash) {
+    unsigned char target[20], computed[20];
+    if (!parseDigest(target_hash, target)) return false;
+    SHA1 sha;
+    sha.update(input);
+    sha.final(computed);
+    return digestsEqual(computed, target);
+}
+
+// ---------------------------------------------------------------------------
+// sha1sum-compatible file hashing. Files are mapped with mmap where the
+// platform has it (large aligned reads otherwise) and hashed in parallel.
+
+// Read size for inputs that cannot be mapped (pipes, stdin)
+const size_t READ_BLOCK = 1 << 20;
+
+// Hash everything readable from fd with large aligned reads
+bool hashDescriptor(int fd, SHA1 &sha) {
+    static thread_local std::vector<uint64_t> storage(READ_BLOCK / 8);
+    unsigned char *buf = reinterpret_cast<unsigned char *>(storage.data());
+    for (;;) {
+        ssize_t n = read(fd, buf, READ_BLOCK);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) return false;
+        if (n == 0) return true;
+        sha.update(buf, size_t(n));
+    }
+}
+
+// Hex digest of one file ("-" is stdin). On failure returns false and
+// leaves the errno value in error; this runs on pool workers, so the
+// caller formats it (std::strerror is not thread-safe).
+bool hashFile(const std::string &path, std::string &hex, int &error) {
+    SHA1 sha;
+    if (path == "-") {
+        if (!hashDescriptor(0, sha)) {
+            error = errno;
+            return false;
+        }
+        hex = sha.final();
+        return true;
+    }
+
+    int fd = open(path.c_str(), O_RDONLY | O_BINARY);
+    if (fd < 0) {
+        error = errno;
+        return false;
+    }
+    struct stat st;
+    bool ok = fstat(fd, &st) == 0;
+    if (ok && S_ISDIR(st.st_mode)) {
+        close(fd);
+        error = EISDIR;
+        return false;
+    }
+    bool mapped = false;
+#ifdef SHA1_MMAP
+    if (ok && S_ISREG(st.st_mode) && st.st_size > 0) {
+        size_t size = size_t(st.st_size);
+        void *map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+            madvise(map, size, MADV_SEQUENTIAL);
+            sha.update(static_cast<const unsigned char *>(map), size);
+            munmap(map, size);
+            mapped = true;
+        }
+    }
+#endif
+    if (ok && !mapped) ok = hashDescriptor(fd, sha);
+    if (!ok) error = errno;
+    close(fd);
+    if (ok) hex = sha.final();
+    return ok;
+}
+
+// Command-line paths with every directory replaced by the regular files
+// below it (sorted, like `find | sort`). Unreadable directories are
+// reported and make status 1.
+std::vector<std::string> expandPaths(const std::vector<std::string> &args, int &status) {
+    std::vector<std::string> paths;
+    for (const std::string &arg : args) {
+        std::error_code ec;
+        if (arg == "-" || !std::filesystem::is_directory(arg, ec)) {
+            paths.push_back(arg);
+            continue;
+        }
+        std::vector<std::string> found;
+        std::filesystem::recursive_directory_iterator it(arg, std::filesystem::directory_options::skip_permission_denied, ec), end;
+        for (; !ec && it != end; it.increment(ec))
+            if (it->is_regular_file(ec)) found.push_back(it->path().string());
+        if (ec) {
+            std::cerr << "exp9: " << arg << ": " << ec.message() << "\n";
+            status = 1;
+        }
+        std::sort(found.begin(), found.end());
+        paths.insert(paths.end(), found.begin(), found.end());
+    }
+    return paths;
+}
+
+struct FileDigest {
+    std::string hex;
+    int error = 0;
+    bool ok = false;
+};
+
+// Hash all paths on the pool, one file per task. Tasks are handed out
+// largest file first from a shared cursor, so a thread that finishes early
+// takes the next waiting file and one huge file does not end up last.
+std::vector<FileDigest> hashFiles(const std::vector<std::string> &paths, ChunkPool &pool = ChunkPool::shared()) {
+    std::vector<std::pair<uintmax_t, size_t>> order;
+    for (size_t i = 0; i < paths.size(); ++i) {
+        std::error_code ec;
+        uintmax_t size = paths[i] == "-" ? 0 : std::filesystem::file_size(paths[i], ec);
+        order.push_back({ec ? 0 : size, i});
+    }
+    std::sort(order.begin(), order.end(), [](const auto &a, const auto &b) { return a.first > b.first; });
+
+    std::vector<FileDigest> results(paths.size());
+    pool.run(order.size(), 1, 1, [&](size_t b, size_t e) {
+        for (size_t k = b; k < e; ++k) {
+            FileDigest &r = results[order[k].second];
+            r.ok = hashFile(paths[order[k].second], r.hex, r.error);
+        }
+    });
+    return results;
+}
+
+// exp9 [FILE|DIR]...: print "<digest>  <path>" per file, as sha1sum does
+int runHashFiles(const std::vector<std::string> &args) {
+    int status = 0;
+    std::vector<std::string> paths = expandPaths(args, status);
+    std::vector<FileDigest> results = hashFiles(paths);
+    for (size_t i = 0; i < paths.size(); ++i) {
+        if (results[i].ok) {
+            std::cout << results[i].hex << "  " << paths[i] << "\n";
+        } else {
+            std::cerr << "exp9: " << paths[i] << ": " << std::strerror(results[i].error) << "\n";
+            status = 1;
+        }
+    }
+    return status;
+}
+
+// exp9 -c CHECKFILE...: verify "<digest>  <path>" lines (sha1sum -c)
+int runCheckFiles(const std::vector<std::string> &checkFiles) {
+    std::vector<std::string> paths, expected;
+    size_t badLines = 0;
+    for (const std::string &name : checkFiles) {
+        std::ifstream in(name == "-" ? "/dev/stdin" : name);
+        if (!in) {
+            std::cerr << "exp9: " << name << ": " << std::strerror(errno) << "\n";
+            return 1;
+        }
+        std::string line;
+        while (std::getline(in, line)) {
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            bool hex = line.size() > 42 && std::all_of(line.begin(), line.begin() + 40, [](unsigned char c) { return std::isxdigit(c) != 0; });
+            if (!hex || line[40] != ' ' || (line[41] != ' ' && line[41] != '*')) {
+                if (!line.empty()) ++badLines;
+                continue;
+            }
+            std::string digest = line.substr(0, 40);
+            toLowerCase(digest);
+            expected.push_back(digest);
+            paths.push_back(line.substr(42));
+        }
+    }
+    if (paths.empty()) {
+        std::cerr << "exp9: no properly formatted SHA1 checksum lines found\n";
+        return 1;
+    }
+
+    std::vector<FileDigest> results = hashFiles(paths);
+    size_t failed = 0, unreadable = 0;
+    for (size_t i = 0; i < paths.size(); ++i) {
+        if (!results[i].ok) {
+            std::cerr << "exp9: " << paths[i] << ": " << std::strerror(results[i].error) << "\n";
+            std::cout << paths[i] << ": FAILED open or read\n";
+            ++unreadable;
+        } else if (results[i].hex != expected[i]) {
+            std::cout << paths[i] << ": FAILED\n";
+            ++failed;
+        } else {
+            std::cout << paths[i] << ": OK\n";
+        }
+    }
+    if (badLines) std::cerr << "exp9: WARNING: " << badLines << " line(s) improperly formatted\n";
+    if (unreadable) std::cerr << "exp9: WARNING: " << unreadable << " listed file(s) could not be read\n";
+    if (failed) std::cerr << "exp9: WARNING: " << failed << " computed checksum(s) did NOT match\n";
+    return failed || unreadable ? 1 : 0;
+}
+
+// ---------------------------------------------------------------------------
+// Tree hashing for single huge files. The file is cut into fixed-size
+// leaves that are hashed in parallel; parents hash their two children, and
+// a node without a sibling moves up unchanged. Leaves and parents get a
+// different prefix byte (0 and 1) so a leaf can never pass for a parent.
+// This gives a different digest from the plain sequential SHA-1, which
+// stays the default.
+
+const size_t DEFAULT_LEAF_SIZE = 1 << 20;
+
+typedef std::array<unsigned char, 20> Digest;
+
+std::string toHex(const Digest &d) {
+    std::string hex(40, '0');
+    encodeHex(d.data(), d.size(), &hex[0]);
+    return hex;
+}
+
+// A whole file in memory: mapped where possible, read otherwise
+class MappedFile {
+public:
+    explicit MappedFile(const std::string &path) {
+        int fd = open(path.c_str(), O_RDONLY | O_BINARY);
+        if (fd < 0) return;
+        struct stat st;
+        if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+            size = size_t(st.st_size);
+            ok = true;
+#ifdef SHA1_MMAP
+            if (size > 0) {
+                void *map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (map != MAP_FAILED) {
+                    mapped = static_cast<const unsigned char *>(map);
+                    close(fd);
+                    return;
+                }
+            }
+#endif
+            copy.resize(size);
+            for (size_t got = 0; ok && got < size;) {
+                ssize_t n = read(fd, copy.data() + got, size - got);
+                if (n < 0 && errno == EINTR) continue;
+                ok = n > 0;
+                if (ok) got += size_t(n);
+            }
+        }
+        close(fd);
+    }
+
+    ~MappedFile() {
+#ifdef SHA1_MMAP
+        if (mapped) munmap(const_cast<unsigned char *>(mapped), size);
+#endif
+    }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    bool valid() const { return ok; }
+    const unsigned char *data() const { return mapped ? mapped : copy.data(); }
+    size_t length() const { return size; }
+
+private:
+    const unsigned char *mapped = nullptr;
+    std::vector<unsigned char> copy;
+    size_t size = 0;
+    bool ok = false;
+};
+
+class MerkleTree {
+public:
+    explicit MerkleTree(size_t leafSize = DEFAULT_LEAF_SIZE) : leaf_size(leafSize) {}
+
+    size_t leafSize() const { return leaf_size; }
+    uint64_t fileSize() const { return file_size; }
+    size_t leafCount() const { return leaves.size(); }
+    const Digest &leaf(size_t i) const { return leaves[i]; }
+
+    // Hash every leaf of data[0, len) on the pool and combine the root
+    void build(const unsigned char *data, size_t len, ChunkPool &pool = ChunkPool::shared()) {
+        file_size = len;
+        leaves.assign(leavesFor(len), Digest());
+        rehashLeaves(data, 0, leaves.size(), pool);
+        combine();
+    }
+
+    // After data changed in [offset, offset + count), re-hash only the
+    // leaves that range touches (and any the new length adds or removes)
+    // and combine again. Returns the number of leaves hashed.
+    size_t update(const unsigned char *data, size_t len, size_t offset, size_t count,
+                  ChunkPool &pool = ChunkPool::shared()) {
+        size_t oldLeaves = leaves.size(), newLeaves = leavesFor(len);
+        size_t first = newLeaves, last = 0;
+        if (count > 0) {
+            first = offset / leaf_size;
+            last = (offset + count - 1) / leaf_size + 1;
+        }
+        if (len != file_size) {
+            // The old and new last leaves may be partial, and everything
+            // past the old end is new
+            first = std::min(first, std::min(oldLeaves, newLeaves) - 1);
+            last = newLeaves;
+        }
+        last = std::min(last, newLeaves);
+        file_size = len;
+        leaves.resize(leavesFor(len));
+        if (first < last) rehashLeaves(data, first, last, pool);
+        combine();
+        return last > first ? last - first : 0;
+    }
+
+    // Leaves in [first, last) whose stored digest does not match data
+    std::vector<size_t> changedLeaves(const unsigned char *data, size_t first, size_t last,
+                                      ChunkPool &pool = ChunkPool::shared()) const {
+        std::vector<char> differs(leaves.size(), 0);
+        last = std::min(last, leaves.size());
+        if (first < last) {
+            pool.run(last - first, 1, 1, [&](size_t b, size_t e) {
+                for (size_t i = first + b; i < first + e; ++i)
+                    differs[i] = hashLeaf(data, i) != leaves[i];
+            });
+        }
+        std::vector<size_t> changed;
+        for (size_t i = first; i < last; ++i)
+            if (differs[i]) changed.push_back(i);
+        return changed;
+    }
+
+    const Digest &root() const { return root_digest; }
+
+    // Tree file: "EXP9MRK1", leaf size, file size and leaf count as
+    // little-endian 64-bit words, then the leaf digests and the root.
+    // Parents are recomputed on load; the stored root catches corruption.
+    bool save(const std::string &path) const {
+        std::ofstream out(path, std::ios::binary);
+        out.write(MAGIC, 8);
+        writeWord(out, leaf_size);
+        writeWord(out, file_size);
+        writeWord(out, leaves.size());
+        for (const Digest &d : leaves) out.write(reinterpret_cast<const char *>(d.data()), 20);
+        out.write(reinterpret_cast<const char *>(root_digest.data()), 20);
+        return bool(out.flush());
+    }
+
+    bool load(const std::string &path) {
+        std::ifstream in(path, std::ios::binary);
+        char magic[8];
+        uint64_t leafSize, fileSize, count;
+        if (!in.read(magic, 8) || std::memcmp(magic, MAGIC, 8) != 0) return false;
+        if (!readWord(in, leafSize) || !readWord(in, fileSize) || !readWord(in, count)) return false;
+        if (leafSize == 0 || count != (fileSize + leafSize - 1) / leafSize + (fileSize == 0)) return false;
+        leaf_size = leafSize;
+        file_size = fileSize;
+        leaves.assign(count, Digest());
+        for (Digest &d : leaves)
+            if (!in.read(reinterpret_cast<char *>(d.data()), 20)) return false;
+        Digest stored;
+        if (!in.read(reinterpret_cast<char *>(stored.data()), 20)) return false;
+        combine();
+        return stored == root_digest;
+    }
+
+private:
+    static constexpr const char *MAGIC = "EXP9MRK1";
+
+    size_t leaf_size;
+    uint64_t file_size = 0;
+    std::vector<Digest> leaves;
+    Digest root_digest{};
+
+    // An empty file still has one (empty) leaf
+    size_t leavesFor(size_t len) const {
+        return len == 0 ? 1 : (len + leaf_size - 1) / leaf_size;
+    }
+
+    Digest hashLeaf(const unsigned char *data, size_t i) const {
+        size_t begin = i * leaf_size;
+        size_t end = std::min<size_t>(file_size, begin + leaf_size);
+        const unsigned char prefix = 0;
+        SHA1 sha;
+        sha.update(&prefix, 1);
+        if (end > begin) sha.update(data + begin, end - begin);
+        Digest d;
+        sha.final(d.data());
+        return d;
+    }
+
+    void rehashLeaves(const unsigned char *data, size_t first, size_t last, ChunkPool &pool) {
+        pool.run(last - first, 1, 1, [&](size_t b, size_t e) {
+            for (size_t i = first + b; i < first + e; ++i) leaves[i] = hashLeaf(data, i);
+        });
+    }
+
+    // Parents level by level; there are only leafCount - 1 of them, so
+    // this is cheap next to the leaves
+    void combine() {
+        std::vector<Digest> level(leaves);
+        while (level.size() > 1) {
+            std::vector<Digest> up((level.size() + 1) / 2);
+            for (size_t i = 0; i + 1 < level.size(); i += 2) {
+                const unsigned char prefix = 1;
+                SHA1 sha;
+                sha.update(&prefix, 1);
+                sha.update(level[i].data(), 20);
+                sha.update(level[i + 1].data(), 20);
+                sha.final(up[i / 2].data());
+            }
+            if (level.size() % 2) up.back() = level.back();
+            level.swap(up);
+        }
+        root_digest = level[0];
+    }
+
+    static void writeWord(std::ofstream &out, uint64_t v) {
+        unsigned char b[8];
+        for (int i = 0; i < 8; ++i) b[i] = (v >> (8 * i)) & 0xFF;
+        out.write(reinterpret_cast<const char *>(b), 8);
+    }
+
+    static bool readWord(std::ifstream &in, uint64_t &v) {
+        unsigned char b[8];
+        if (!in.read(reinterpret_cast<char *>(b), 8)) return false;
+        v = 0;
+        for (int i = 0; i < 8; ++i) v |= uint64_t(b[i]) << (8 * i);
+        return true;
+    }
+};
+
+// "OFFSET:LENGTH" in bytes
+bool parseRange(const std::string &s, size_t &offset, size_t &length) {
+    size_t colon = s.find(':');
+    if (colon == std::string::npos) return false;
+    char *end;
+    offset = std::strtoull(s.c_str(), &end, 10);
+    if (end != s.c_str() + colon) return false;
+    length = std::strtoull(s.c_str() + colon + 1, &end, 10);
+    return *end == '\0';
+}
+
+// exp9 --tree FILE [TREEFILE [LEAF_KIB]]: root of the tree hash, optionally
+// storing the tree
+int runTreeHash(const std::vector<std::string> &args) {
+    MappedFile file(args[0]);
+    if (!file.valid()) {
+        std::cerr << "exp9: " << args[0] << ": cannot read\n";
+        return 1;
+    }
+    size_t leafSize = args.size() > 2 ? std::strtoull(args[2].c_str(), nullptr, 10) << 10 : DEFAULT_LEAF_SIZE;
+    MerkleTree tree(leafSize ? leafSize : DEFAULT_LEAF_SIZE);
+    tree.build(file.data(), file.length());
+    std::cout << toHex(tree.root()) << "  " << args[0] << "\n";
+    if (args.size() > 1 && !tree.save(args[1])) {
+        std::cerr << "exp9: " << args[1] << ": cannot write tree\n";
+        return 1;
+    }
+    return 0;
+}
+
+// exp9 --tree-verify FILE TREEFILE [OFFSET:LENGTH]: compare the file (or
+// just the leaves under one byte range) with a stored tree
+// exp9 --tree-update FILE TREEFILE OFFSET:LENGTH...: re-hash only the
+// leaves under the given ranges and rewrite the stored tree
+int runTreeCheck(bool update, const std::vector<std::string> &args) {
+    MappedFile file(args[0]);
+    MerkleTree tree;
+    if (!file.valid()) {
+        std::cerr << "exp9: " << args[0] << ": cannot read\n";
+        return 1;
+    }
+    if (!tree.load(args[1])) {
+        std::cerr << "exp9: " << args[1] << ": not a valid tree file\n";
+        return 1;
+    }
+
+    std::vector<std::pair<size_t, size_t>> ranges;
+    for (size_t i = 2; i < args.size(); ++i) {
+        size_t offset, length;
+        if (!parseRange(args[i], offset, length)) {
+            std::cerr << "exp9: expected OFFSET:LENGTH, got " << args[i] << "\n";
+            return 1;
+        }
+        ranges.push_back({offset, length});
+    }
+
+    if (update) {
+        size_t hashed = 0;
+        if (ranges.empty()) ranges.push_back({0, 0});
+        for (const auto &r : ranges) hashed += tree.update(file.data(), file.length(), r.first, r.second);
+        if (!tree.save(args[1])) {
+            std::cerr << "exp9: " << args[1] << ": cannot write tree\n";
+            return 1;
+        }
+        std::cout << toHex(tree.root()) << "  " << args[0] << "  (" << hashed << " of " << tree.leafCount()
+                  << " leaves re-hashed)\n";
+        return 0;
+    }
+
+    if (file.length() != tree.fileSize()) {
+        std::cout << args[0] << ": FAILED (size " << file.length() << ", tree has " << tree.fileSize() << ")\n";
+        return 1;
+    }
+    size_t first = 0, last = tree.leafCount();
+    if (!ranges.empty()) {
+        first = std::min(ranges[0].first / tree.leafSize(), tree.leafCount());
+        last = ranges[0].second ? (ranges[0].first + ranges[0].second - 1) / tree.leafSize() + 1 : first;
+        last = std::max(first, std::min(last, tree.leafCount()));
+    }
+    std::vector<size_t> changed = tree.changedLeaves(file.data(), first, last);
+    for (size_t i : changed) {
+        size_t begin = i * tree.leafSize();
+        std::cout << "  changed: bytes " << begin << "-" << std::min<uint64_t>(tree.fileSize(), begin + tree.leafSize()) - 1
+                  << "\n";
+    }
+    std::cout << args[0] << ": " << (changed.empty() ? "OK" : "FAILED") << " (" << last - first << " leaves checked)\n";
+    return changed.empty() ? 0 : 1;
+}
+
+// ---------------------------------------------------------------------------
+// Resumable hashing: the running state is checkpointed to a file, so a
+// hash interrupted by a crash or restart continues where it stopped.
+
+// Write through a temporary file and rename it over the old checkpoint, so
+// an interruption leaves either the previous or the new one intact
+bool writeCheckpoint(const std::string &path, const SHA1 &sha) {
+    unsigned char state[SHA1::STATE_SIZE];
+    if (!sha.saveState(state)) return false;
+    std::string tmp = path + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        if (!out.write(reinterpret_cast<const char *>(state), sizeof(state)).flush()) return false;
+    }
+    return std::rename(tmp.c_str(), path.c_str()) == 0;
+}
+
+// exp9 --resume STATEFILE FILE [CHECKPOINT_MIB]: hash FILE ("-" for stdin),
+// continuing from STATEFILE if it exists and checkpointing into it as it
+// goes. A file is read from the saved offset and must be at least that
+// long. Stdin cannot be rewound, so it only resumes as "-:OFFSET", the
+// caller's word that the stream starts at byte OFFSET of the data, which
+// must be where the state stopped. The state file is removed once the
+// digest is printed.
+int runResumableHash(const std::vector<std::string> &args) {
+    const std::string &statePath = args[0];
+    std::string path = args[1];
+    bool fromStdin = path == "-" || path.compare(0, 2, "-:") == 0;
+    uint64_t stdinOffset = 0;
+    if (path.size() > 2 && fromStdin) {
+        char *end = nullptr;
+        stdinOffset = std::strtoull(path.c_str() + 2, &end, 10);
+        if (*end != 0) {
+            std::cerr << "exp9: " << path << ": expected -:OFFSET\n";
+            return 1;
+        }
+    }
+    if (fromStdin) path = "-";
+    size_t checkpoint = (args.size() > 2 ? std::strtoull(args[2].c_str(), nullptr, 10) : 64) << 20;
+    if (checkpoint == 0) checkpoint = 64 << 20;
+
+    SHA1 sha;
+    std::ifstream saved(statePath, std::ios::binary);
+    if (saved) {
+        unsigned char state[SHA1::STATE_SIZE + 1];
+        saved.read(reinterpret_cast<char *>(state), sizeof(state));
+        if (!sha.restoreState(state, size_t(saved.gcount()))) {
+            std::cerr << "exp9: " << statePath << ": not a valid SHA-1 state\n";
+            return 1;
+        }
+        std::cerr << "exp9: resuming after " << sha.bytesHashed() << " bytes\n";
+    }
+    if (fromStdin && stdinOffset != sha.bytesHashed()) {
+        std::cerr << "exp9: stdin must start at byte " << sha.bytesHashed() << " of the data; pass -:"
+                  << sha.bytesHashed() << " once it does\n";
+        return 1;
+    }
+
+    int fd = fromStdin ? 0 : open(path.c_str(), O_RDONLY | O_BINARY);
+    struct stat st;
+    if (fd < 0 || (fd != 0 && (fstat(fd, &st) != 0 || lseek(fd, off_t(sha.bytesHashed()), SEEK_SET) < 0))) {
+        std::cerr << "exp9: " << path << ": " << std::strerror(errno) << "\n";
+        return 1;
+    }
+    // lseek past the end succeeds, and the read after it just sees EOF
+    if (fd != 0 && S_ISREG(st.st_mode) && uint64_t(st.st_size) < sha.bytesHashed()) {
+        std::cerr << "exp9: " << path << ": shorter (" << st.st_size << " bytes) than the saved state ("
+                  << sha.bytesHashed() << " bytes)\n";
+        close(fd);
+        return 1;
+    }
+    std::vector<unsigned char> buf(READ_BLOCK);
+    size_t sinceCheckpoint = 0;
+    for (;;) {
+        ssize_t n = read(fd, buf.data(), buf.size());
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) {
+            std::cerr << "exp9: " << path << ": " << std::strerror(errno) << "\n";
+            writeCheckpoint(statePath, sha);
+            return 1;
+        }
+        if (n == 0) break;
+        sha.update(buf.data(), size_t(n));
+        sinceCheckpoint += size_t(n);
+        if (sinceCheckpoint >= checkpoint) {
+            if (!writeCheckpoint(statePath, sha)) {
+                std::cerr << "exp9: " << statePath << ": cannot write checkpoint\n";
+                return 1;
+            }
+            sinceCheckpoint = 0;
+        }
+    }
+    if (fd != 0) close(fd);
+    std::cout << sha.final() << "  " << path << "\n";
+    std::remove(statePath.c_str());
+    return 0;
+}
+
+// exp9 --pbkdf2 PASSWORD SALT ITERATIONS [DKLEN]: hex PBKDF2-HMAC-SHA1 key
+int runPbkdf2(const std::vector<std::string> &args) {
+    unsigned long iterations = std::strtoul(args[2].c_str(), nullptr, 10);
+    unsigned long len = args.size() > 3 ? std::strtoul(args[3].c_str(), nullptr, 10) : 20;
+    if (iterations == 0 || iterations > 0xFFFFFFFFul || len == 0 || len > 1 << 16) {
+        std::cerr << "exp9: ITERATIONS and DKLEN must be positive\n";
+        return 1;
+    }
+    std::vector<unsigned char> key(len);
+    pbkdf2HmacSha1(reinterpret_cast<const unsigned char*>(args[0].data()), args[0].size(),
+                   reinterpret_cast<const unsigned char*>(args[1].data()), args[1].size(), uint32_t(iterations),
+                   key.data(), len);
+    std::string hex(2 * len, '0');
+    encodeHex(key.data(), len, &hex[0]);
+    std::cout << hex << "\n";
+    return 0;
+}
+
+// FIPS 180 / NIST example vectors: (message, repeat count, digest)
+struct TestVector {
+    const char *message;
+    size_t repeat;
+    const char *digest;
+};
+
+const TestVector TEST_VECTORS[] = {
+    {"abc", 1, "a9993e364706816aba3e25717850c26c9cd0d89d"},
+    {"", 1, "da39a3ee5e6b4b0d3255bfef95601890afd80709"},
+    {"abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", 1, "84983e441c3bd26ebaae4aa1f95129e5e54670f1"},
+    {"abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmnhijklmnoijklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu",
+     1, "a49b2446a02c645bf419f995b67091253a04a259"},
+    {"a", 1000000, "34aa973cd4c4daa4f61eeb2bdbad27316534016f"},
+    {"0123456701234567012345670123456701234567012345670123456701234567", 10,
+     "dea356a2cddd90c7a7ecedc5ebb563934f460452"},
+};
+
+template <typename Hasher>
+std::string hashVector(Hasher sha, const TestVector &v) {
+    for (size_t i = 0; i < v.repeat; ++i) sha.update(v.message);
+    return sha.final();
+}
+
+double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Time stamp counter where there is one, for cycles/byte
+inline uint64_t readCycles() {
+#ifdef SHA1_X86
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+// Check every backend and the reference against the vectors, then against
+// each other for many lengths fed in uneven pieces
+bool checkImplementations(const std::vector<unsigned char> &data) {
+    bool ok = true;
+    for (const TestVector &v : TEST_VECTORS) {
+        bool pass = hashVector(reference::SHA1(), v) == v.digest;
+        for (int b = sha1kernel::Scalar; b <= sha1kernel::SHANI; ++b)
+            if (sha1kernel::supported(sha1kernel::Backend(b)))
+                pass = pass && hashVector(SHA1(sha1kernel::Backend(b)), v) == v.digest;
+        std::string label = *v.message ? std::string(v.message).substr(0, 24) : "(empty)";
+        std::cout << "  " << label << (v.repeat > 1 ? " x" + std::to_string(v.repeat) : "")
+                  << (pass ? "  ok" : "  FAILED") << "\n";
+        ok = ok && pass;
+    }
+
+    for (size_t len = 0; len < 300 && ok; ++len) {
+        reference::SHA1 ref;
+        ref.update(data.data(), len);
+        std::string expected = ref.final();
+        for (int b = sha1kernel::Scalar; b <= sha1kernel::SHANI; ++b) {
+            if (!sha1kernel::supported(sha1kernel::Backend(b))) continue;
+            for (size_t piece = 1; piece <= 131; piece += 13) {
+                SHA1 sha{sha1kernel::Backend(b)};
+                for (size_t off = 0; off < len; off += piece)
+                    sha.update(data.data() + off, std::min(piece, len - off));
+                if (sha.final() != expected) {
+                    std::cout << "Mismatch with the reference (" << sha1kernel::backendName(sha1kernel::Backend(b))
+                              << ") for length " << len << ", pieces of " << piece << "\n";
+                    return false;
+                }
+            }
+        }
+    }
+    return ok;
+}
+
+// Records/s for many independent messages of one size: hashString per
+// record (hex digest) against hashMany at each supported lane count
+bool runBatchBenchmark(const std::vector<unsigned char> &data) {
+    std::cout << "Independent records, records/s (hashString vs hashMany lanes)\n";
+    for (size_t size = 16; size <= 4096; size *= 4) {
+        size_t count = std::max<size_t>(20000, (32 << 20) / size);
+        std::vector<const unsigned char *> ptrs(count);
+        std::vector<size_t> lens(count, size);
+        for (size_t i = 0; i < count; ++i) ptrs[i] = data.data() + (i * 4099) % (data.size() - size);
+        std::vector<std::array<unsigned char, 20>> digests(count);
+
+        size_t sample = std::min<size_t>(count, 50000);
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::string> hex(sample);
+        for (size_t i = 0; i < sample; ++i)
+            hex[i] = hashString(std::string(ptrs[i], ptrs[i] + size));
+        double t = secondsSince(start);
+        std::cout << "  " << std::setw(4) << size << " B   hashString " << sample / t / 1e6 << " M/s";
+
+        for (int lanes = 4; lanes <= 16; lanes *= 2) {
+            if (!sha1kernel::lanesSupported(lanes)) continue;
+            start = std::chrono::steady_clock::now();
+            hashMany(ptrs.data(), lens.data(), count, digests.data(), lanes);
+            t = secondsSince(start);
+            for (size_t i = 0; i < sample; i += 97) {
+                char computed[40];
+                encodeHex(digests[i].data(), 20, computed);
+                if (std::string(computed, 40) != hex[i]) {
+                    std::cout << "\nhashMany (" << lanes << " lanes) disagrees with SHA1 for record " << i << "\n";
+                    return false;
+                }
+            }
+            std::cout << "   x" << lanes << " " << count / t / 1e6 << " M/s";
+        }
+        std::cout << "\n";
+    }
+
+    // Mixed lengths, so lanes finish at different times and are refilled
+    std::vector<const unsigned char *> ptrs;
+    std::vector<size_t> lens;
+    for (size_t i = 0; i < 5000; ++i) {
+        lens.push_back((i * 7919) % 700);
+        ptrs.push_back(data.data() + i * 31);
+    }
+    std::vector<std::array<unsigned char, 20>> mixed(ptrs.size()), single(ptrs.size());
+    for (int lanes = 4; lanes <= 16; lanes *= 2) {
+        if (!sha1kernel::lanesSupported(lanes)) continue;
+        hashMany(ptrs.data(), lens.data(), ptrs.size(), mixed.data(), lanes);
+        hashMany(ptrs.data(), lens.data(), 1, single.data(), lanes);
+        for (size_t i = 0; i < ptrs.size(); ++i) {
+            SHA1 sha;
+            sha.update(ptrs[i], lens[i]);
+            std::string expected = sha.final();
+            char computed[40];
+            encodeHex(mixed[i].data(), 20, computed);
+            if (std::string(computed, 40) != expected) {
+                std::cout << "hashMany (" << lanes << " lanes) wrong for mixed-length record " << i << "\n";
+                return false;
+            }
+        }
+        if (single[0] != mixed[0]) return false;
+    }
+    std::cout << "  mixed-length batches match SHA1\n";
+    return true;
+}
+
+// Tree hash of one big buffer on 1..N threads against the sequential
+// digest, plus a check that an incremental update matches a full rebuild
+bool runTreeBenchmark(const std::vector<unsigned char> &sample, size_t mib) {
+    size_t total = mib << 20;
+    std::vector<unsigned char> big(total);
+    for (size_t off = 0; off < total; off += sample.size())
+        std::memcpy(&big[off], sample.data(), std::min(sample.size(), total - off));
+    double mb = double(total) / (1 << 20);
+
+    auto start = std::chrono::steady_clock::now();
+    SHA1 sha;
+    sha.update(big.data(), big.size());
+    sha.final();
+    double tSeq = secondsSince(start);
+    std::cout << "Tree hash over " << mib << " MiB (" << DEFAULT_LEAF_SIZE / 1024 << " KiB leaves)\n";
+    std::cout << "  sequential SHA1     : " << mb / tSeq << " MB/s\n";
+
+    double tOne = 0;
+    MerkleTree tree;
+    for (unsigned threads : scalingThreadCounts()) {
+        ChunkPool pool(threads);
+        start = std::chrono::steady_clock::now();
+        tree.build(big.data(), big.size(), pool);
+        double t = secondsSince(start);
+        if (threads == 1) tOne = t;
+        std::cout << "  " << threads << " thread(s)         : " << mb / t << " MB/s, speedup " << tOne / t << "x\n";
+    }
+
+    big[total / 3] ^= 1;
+    start = std::chrono::steady_clock::now();
+    size_t hashed = tree.update(big.data(), big.size(), total / 3, 1);
+    double tUpdate = secondsSince(start);
+    MerkleTree full;
+    full.build(big.data(), big.size());
+    if (full.root() != tree.root() || hashed != 1) {
+        std::cout << "Incremental tree update does not match a full rebuild\n";
+        return false;
+    }
+    std::cout << "  one-byte update     : " << tUpdate * 1e3 << " ms (1 of " << tree.leafCount() << " leaves)\n";
+    return true;
+}
+
+// Snapshots and saved states must continue exactly like the original
+// context; then time many suffixes after a shared 4 KiB prefix, hashing
+// the prefix every time against once plus a snapshot per suffix
+bool runPrefixBenchmark(const std::vector<unsigned char> &data) {
+    for (size_t split = 0; split < 300; split += 7) {
+        SHA1 whole, first;
+        whole.update(data.data(), 300);
+        first.update(data.data(), split);
+        unsigned char state[SHA1::STATE_SIZE];
+        SHA1 copy = first.snapshot(), restored;
+        if (!first.saveState(state) || !restored.restoreState(state, sizeof(state))) {
+            std::cout << "SHA-1 state did not save or restore at " << split << " bytes\n";
+            return false;
+        }
+        first.update(data.data() + split, 300 - split);
+        copy.update(data.data() + split, 300 - split);
+        restored.update(data.data() + split, 300 - split);
+        std::string expected = whole.final();
+        if (first.final() != expected || copy.final() != expected || restored.final() != expected) {
+            std::cout << "Snapshot or restored state diverged at " << split << " bytes\n";
+            return false;
+        }
+    }
+    unsigned char state[SHA1::STATE_SIZE];
+    SHA1 sha;
+    sha.update(data.data(), 10);
+    sha.saveState(state);
+    state[36] = 11; // tail length that does not match the byte count
+    if (sha.restoreState(state, sizeof(state))) {
+        std::cout << "restoreState accepted an inconsistent state\n";
+        return false;
+    }
+
+    const size_t prefixLen = 4096, suffixes = 50000;
+    volatile unsigned char sink = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < suffixes; ++i) {
+        SHA1 full;
+        full.update(data.data(), prefixLen);
+        full.update(data.data() + prefixLen + i, 40);
+        unsigned char digest[20];
+        full.final(digest);
+        sink ^= digest[0];
+    }
+    double tFull = secondsSince(start);
+    start = std::chrono::steady_clock::now();
+    SHA1 prefix;
+    prefix.update(data.data(), prefixLen);
+    for (size_t i = 0; i < suffixes; ++i) {
+        SHA1 h = prefix.snapshot();
+        h.update(data.data() + prefixLen + i, 40);
+        unsigned char digest[20];
+        h.final(digest);
+        sink ^= digest[0];
+    }
+    double tSnapshot = secondsSince(start);
+    std::cout << "40-byte suffixes after a 4 KiB prefix\n";
+    std::cout << "  prefix hashed each time   : " << suffixes / tFull / 1e6 << " M messages/s\n";
+    std::cout << "  prefix once + snapshot    : " << suffixes / tSnapshot / 1e6 << " M messages/s\n";
+    return true;
+}
+
+// verifyHash before (string formatting, lower-casing, string compare) and
+// after (parse the target once per call, compare raw digests)
+bool runVerifyBenchmark(const std::vector<unsigned char> &data) {
+    std::vector<std::string> inputs, targets;
+    for (size_t i = 0; i < 1000; ++i) {
+        inputs.push_back(std::string(data.begin() + i * 7, data.begin() + i * 7 + 32));
+        std::string hex = hashString(inputs.back());
+        if (i % 2) std::transform(hex.begin(), hex.end(), hex.begin(), ::toupper);
+        if (i % 5 == 0) hex[i % 40] = hex[i % 40] == '0' ? '1' : '0';
+        targets.push_back(hex);
+    }
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        if (verifyHash(inputs[i], targets[i]) != reference::verifyHash(inputs[i], targets[i]) ||
+            verifyHash(inputs[i], targets[i]) != (i % 5 != 0)) {
+            std::cout << "verifyHash disagrees with the original for input " << i << "\n";
+            return false;
+        }
+    }
+    unsigned char raw[20];
+    if (parseDigest("zz39a3ee5e6b4b0d3255bfef95601890afd80709", raw) || parseDigest("da39", raw) ||
+        !parseDigest("DA39A3EE5E6B4B0D3255BFEF95601890AFD80709", raw)) {
+        std::cout << "parseDigest accepts or rejects the wrong input\n";
+        return false;
+    }
+
+    const size_t rounds = 200;
+    volatile size_t matches = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t r = 0; r < rounds; ++r)
+        for (size_t i = 0; i < inputs.size(); ++i) matches += reference::verifyHash(inputs[i], targets[i]);
+    double tBefore = secondsSince(start);
+    // The same string steps on top of the current SHA1, to separate the
+    // formatting cost from the hashing
+    start = std::chrono::steady_clock::now();
+    for (size_t r = 0; r < rounds; ++r) {
+        for (size_t i = 0; i < inputs.size(); ++i) {
+            std::string computed = hashString(inputs[i]), target = targets[i];
+            toLowerCase(computed);
+            toLowerCase(target);
+            matches += computed == target;
+        }
+    }
+    double tStrings = secondsSince(start);
+    start = std::chrono::steady_clock::now();
+    for (size_t r = 0; r < rounds; ++r)
+        for (size_t i = 0; i < inputs.size(); ++i) matches += verifyHash(inputs[i], targets[i]);
+    double tAfter = secondsSince(start);
+
+    double n = double(rounds * inputs.size());
+    std::cout << "verifyHash on 32-byte messages\n";
+    std::cout << "  original                  : " << n / tBefore / 1e6 << " M verifications/s\n";
+    std::cout << "  string compare, new SHA1  : " << n / tStrings / 1e6 << " M verifications/s\n";
+    std::cout << "  raw digest compare        : " << n / tAfter / 1e6 << " M verifications/s\n";
+    return true;
+}
+
+// RFC 2202 HMAC-SHA1 cases (key, message, MAC); the last key is longer
+// than a block and gets hashed first
+struct HmacVector {
+    std::string key, message;
+    const char *mac;
+};
+
+const HmacVector HMAC_VECTORS[] = {
+    {std::string(20, '\x0b'), "Hi There", "b617318655057264e28bc0b6fb378c8ef146be00"},
+    {"Jefe", "what do ya want for nothing?", "effcdf6ae5eb2fa2d27416d5f184df9c259a7c79"},
+    {std::string(80, '\xaa'), "Test Using Larger Than Block-Size Key - Hash Key First",
+     "aa4ae5e15272d00e95705637ce8a3b55ed402112"},
+};
+
+// RFC 6070 PBKDF2-HMAC-SHA1 cases (password, salt, c, derived key), less
+// the one with c = 16777216
+struct Pbkdf2Vector {
+    std::string password, salt;
+    uint32_t iterations;
+    const char *key;
+};
+
+const Pbkdf2Vector PBKDF2_VECTORS[] = {
+    {"password", "salt", 1, "0c60c80f961f0e71f3a9b524af6012062fe037a6"},
+    {"password", "salt", 2, "ea6c014dc72d6f8ccd1ed92ace1d41f0d8de8957"},
+    {"password", "salt", 4096, "4b007901b765489abead49d926f721d065a429c1"},
+    {"passwordPASSWORDpassword", "saltSALTsaltSALTsaltSALTsaltSALTsalt", 4096,
+     "3d2eec4fe41c849b80c8d83662c0e44a8b291a964cf2f07038"},
+    {std::string("pass\0word", 9), std::string("sa\0lt", 5), 4096, "56fa6aa75548099dcc37d7f03425e0c3"},
+};
+
+// HMAC and PBKDF2 the way callers had to build them on SHA1: both key
+// blocks hashed again for every MAC, and a fresh buffer per iteration
+void hmacWrapped(const std::string &key, const unsigned char *msg, size_t len, unsigned char mac[20]) {
+    std::vector<unsigned char> ipad(64, 0), opad;
+    if (key.size() > 64) {
+        SHA1 sha;
+        sha.update(key);
+        sha.final(ipad.data());
+    } else {
+        std::copy(key.begin(), key.end(), ipad.begin());
+    }
+    opad = ipad;
+    for (size_t i = 0; i < 64; ++i) {
+        ipad[i] ^= 0x36;
+        opad[i] ^= 0x5c;
+    }
+    unsigned char digest[20];
+    SHA1 in;
+    in.update(ipad.data(), 64);
+    in.update(msg, len);
+    in.final(digest);
+    SHA1 out;
+    out.update(opad.data(), 64);
+    out.update(digest, 20);
+    out.final(mac);
+}
+
+void pbkdf2Wrapped(const std::string &password, const std::string &salt, uint32_t iterations, unsigned char key[20]) {
+    std::vector<unsigned char> msg(salt.begin(), salt.end());
+    msg.insert(msg.end(), {0, 0, 0, 1});
+    unsigned char u[20];
+    hmacWrapped(password, msg.data(), msg.size(), u);
+    std::memcpy(key, u, 20);
+    for (uint32_t i = 1; i < iterations; ++i) {
+        std::vector<unsigned char> prev(u, u + 20);
+        hmacWrapped(password, prev.data(), prev.size(), u);
+        for (int j = 0; j < 20; ++j) key[j] ^= u[j];
+    }
+}
+
+// HMAC and PBKDF2 against the RFC vectors, the batch against single
+// derivations, then iterations/s for each way of running PBKDF2
+bool runPbkdf2Benchmark() {
+    for (const HmacVector &v : HMAC_VECTORS) {
+        unsigned char wrapped[20];
+        hmacWrapped(v.key, reinterpret_cast<const unsigned char*>(v.message.data()), v.message.size(), wrapped);
+        char hex[40];
+        encodeHex(wrapped, 20, hex);
+        if (HmacSHA1(v.key).mac(v.message) != v.mac || std::string(hex, 40) != v.mac) {
+            std::cout << "HMAC-SHA1 wrong for key of " << v.key.size() << " bytes\n";
+            return false;
+        }
+    }
+    for (const Pbkdf2Vector &v : PBKDF2_VECTORS) {
+        size_t len = std::strlen(v.key) / 2;
+        unsigned char expected[32], key[32];
+        std::array<unsigned char, 20> batch[1];
+        decodeHex(v.key, len, expected);
+        pbkdf2HmacSha1(reinterpret_cast<const unsigned char*>(v.password.data()), v.password.size(),
+                       reinterpret_cast<const unsigned char*>(v.salt.data()), v.salt.size(), v.iterations, key, len);
+        bool ok = digestsEqual(key, expected, len);
+        for (int lanes = 4; lanes <= 16; lanes *= 2) {
+            if (!sha1kernel::lanesSupported(lanes)) continue;
+            pbkdf2HmacSha1Many(&v.password, 1, reinterpret_cast<const unsigned char*>(v.salt.data()), v.salt.size(),
+                               v.iterations, batch, lanes);
+            ok = ok && digestsEqual(batch[0].data(), expected, std::min<size_t>(len, 20));
+        }
+        if (!ok) {
+            std::cout << "PBKDF2-HMAC-SHA1 wrong for c=" << v.iterations << ", dkLen=" << len << "\n";
+            return false;
+        }
+    }
+
+    const std::string salt = "saltSALTsaltSALT";
+    const unsigned char *saltBytes = reinterpret_cast<const unsigned char*>(salt.data());
+    const uint32_t c = 4096;
+    std::vector<std::string> passwords;
+    for (int i = 0; i < 256; ++i) passwords.push_back("password" + std::to_string(i));
+    std::vector<std::array<unsigned char, 20>> single(passwords.size()), batch(passwords.size());
+    const size_t checked = 37; // not a multiple of any lane count
+    for (size_t i = 0; i < checked; ++i)
+        pbkdf2HmacSha1(reinterpret_cast<const unsigned char*>(passwords[i].data()), passwords[i].size(),
+                       saltBytes, salt.size(), c, single[i].data(), 20);
+
+    std::cout << "PBKDF2-HMAC-SHA1, c=" << c << ", M iterations/s\n";
+    const size_t slow = 8;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < slow; ++i) {
+        unsigned char key[20];
+        pbkdf2Wrapped(passwords[i], salt, c, key);
+        if (std::memcmp(key, single[i].data(), 20) != 0) {
+            std::cout << "PBKDF2 on HMAC wrapped around SHA1 disagrees for password " << i << "\n";
+            return false;
+        }
+    }
+    double t = secondsSince(start);
+    std::cout << "  HMAC wrapped around SHA1   : " << slow * c / t / 1e6 << "\n";
+
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < slow; ++i) {
+        HmacSHA1 hmac(passwords[i]);
+        unsigned char u[20], key[20];
+        pbkdf2First(hmac, saltBytes, salt.size(), 1, u);
+        std::memcpy(key, u, 20);
+        for (uint32_t j = 1; j < c; ++j) {
+            hmac.mac(u, 20, u);
+            for (int k = 0; k < 20; ++k) key[k] ^= u[k];
+        }
+        if (std::memcmp(key, single[i].data(), 20) != 0) return false;
+    }
+    t = secondsSince(start);
+    std::cout << "  HmacSHA1::mac per iteration: " << slow * c / t / 1e6 << "\n";
+
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < passwords.size(); ++i) {
+        unsigned char key[20];
+        pbkdf2HmacSha1(reinterpret_cast<const unsigned char*>(passwords[i].data()), passwords[i].size(),
+                       saltBytes, salt.size(), c, key, 20);
+    }
+    t = secondsSince(start);
+    std::cout << "  pbkdf2HmacSha1 (" << std::left << std::setw(6)
+              << sha1kernel::backendName(sha1kernel::best()) << std::right << ")    : "
+              << passwords.size() * c / t / 1e6 << "\n";
+
+    for (int lanes = 4; lanes <= 16; lanes *= 2) {
+        if (!sha1kernel::lanesSupported(lanes)) continue;
+        pbkdf2HmacSha1Many(passwords.data(), checked, saltBytes, salt.size(), c, batch.data(), lanes);
+        for (size_t i = 0; i < checked; ++i)
+            if (batch[i] != single[i]) {
+                std::cout << "pbkdf2HmacSha1Many (" << lanes << " lanes) disagrees for password " << i << "\n";
+                return false;
+            }
+        start = std::chrono::steady_clock::now();
+        pbkdf2HmacSha1Many(passwords.data(), passwords.size(), saltBytes, salt.size(), c, batch.data(), lanes);
+        t = secondsSince(start);
+        std::cout << "  pbkdf2HmacSha1Many x" << std::setw(2) << std::left << lanes << std::right
+                  << "     : " << passwords.size() * c / t / 1e6 << "\n";
+    }
+    std::cout << "  RFC 2202 / RFC 6070 vectors pass\n";
+    return true;
+}
+
+// Bulk throughput of the reference and each backend, then short messages
+int runBenchmark(size_t mib) {
+    std::vector<unsigned char> data(1 << 20);
+    unsigned int seed = 12345;
+    for (unsigned char &c : data) {
+        seed = seed * 1103515245 + 12345;
+        c = seed >> 16;
+    }
+    if (!checkImplementations(data)) return 1;
+
+    size_t total = mib << 20;
+    double mb = double(total) / (1 << 20);
+    auto start = std::chrono::steady_clock::now();
+    uint64_t cycles = readCycles();
+    reference::SHA1 ref;
+    for (size_t done = 0; done < total; done += data.size())
+        ref.update(data.data(), data.size());
+    std::string refDigest = ref.final();
+    cycles = readCycles() - cycles;
+    double t = secondsSince(start);
+
+    std::cout << "SHA-1 throughput over " << mib << " MiB\n";
+    std::cout << "  reference (vector buffer) : " << mb / t << " MB/s";
+    if (cycles) std::cout << ", " << double(cycles) / total << " cycles/byte";
+    std::cout << "\n";
+
+    for (int b = sha1kernel::Scalar; b <= sha1kernel::SHANI; ++b) {
+        auto backend = sha1kernel::Backend(b);
+        if (!sha1kernel::supported(backend)) continue;
+        start = std::chrono::steady_clock::now();
+        cycles = readCycles();
+        SHA1 sha(backend);
+        for (size_t done = 0; done < total; done += data.size())
+            sha.update(data.data(), data.size());
+        std::string digest = sha.final();
+        cycles = readCycles() - cycles;
+        t = secondsSince(start);
+        if (digest != refDigest) {
+            std::cout << "Digest mismatch over " << mib << " MiB (" << sha1kernel::backendName(backend) << ")\n";
+            return 1;
+        }
+        std::string label = std::string(sha1kernel::backendName(backend)) + (backend == sha1kernel::best() ? " (default)" : "");
+        label.resize(26, ' ');
+        std::cout << "  " << label << ": " << mb / t << " MB/s";
+        if (cycles) std::cout << ", " << double(cycles) / total << " cycles/byte";
+        std::cout << "\n";
+    }
+
+    // Short messages fed a few bytes at a time, where the per-byte
+    // buffering dominated rather than the compression function
+    const size_t messages = 200000;
+    start = std::chrono::steady_clock::now();
+    for (size_t m = 0; m < messages; ++m) {
+        reference::SHA1 r;
+        for (size_t off = 0; off < 200; off += 8) r.update(data.data() + m % 4096 + off, 8);
+        r.final();
+    }
+    double tRef = secondsSince(start);
+    start = std::chrono::steady_clock::now();
+    for (size_t m = 0; m < messages; ++m) {
+        SHA1 h;
+        for (size_t off = 0; off < 200; off += 8) h.update(data.data() + m % 4096 + off, 8);
+        h.final();
+    }
+    double tNew = secondsSince(start);
+    std::cout << "200-byte messages in 8-byte updates\n";
+    std::cout << "  reference (vector buffer) : " << messages / tRef / 1e6 << " M messages/s\n";
+    std::cout << "  SHA1                      : " << messages / tNew / 1e6 << " M messages/s\n";
+    bool ok = runVerifyBenchmark(data) && runPrefixBenchmark(data) && runBatchBenchmark(data) && runPbkdf2Benchmark() &&
+              runTreeBenchmark(data, mib);
+    return ok ? 0 : 1;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc > 1) {
+        std::string mode = argv[1];
+        if (mode == "--bench") {
+            size_t mib = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 256;
+            return runBenchmark(mib ? mib : 256);
+        }
+        std::vector<std::string> args(argv + 2, argv + argc);
+        if (mode == "--tree" && !args.empty()) return runTreeHash(args);
+        if (mode == "--tree-verify" && args.size() >= 2) return runTreeCheck(false, args);
+        if (mode == "--tree-update" && args.size() >= 2) return runTreeCheck(true, args);
+        if (mode == "--resume" && args.size() >= 2) return runResumableHash(args);
+        if (mode == "--pbkdf2" && args.size() >= 3) return runPbkdf2(args);
+        if (mode == "-c") return runCheckFiles(args.empty() ? std::vector<std::string>{"-"} : args);
+        if (mode == "-h" || mode == "--help") {
+            std::cerr << "Usage: " << argv[0] << " [FILE|DIR... | -c CHECKFILE... | --bench [MiB]]\n"
+                      << "       " << argv[0] << " --tree FILE [TREEFILE [LEAF_KIB]]\n"
+                      << "       " << argv[0] << " --tree-verify|--tree-update FILE TREEFILE [OFFSET:LENGTH...]\n"
+                      << "       " << argv[0] << " --resume STATEFILE FILE|-[:OFFSET] [CHECKPOINT_MIB]\n"
+                      << "       " << argv[0] << " --pbkdf2 PASSWORD SALT ITERATIONS [DKLEN]" << std::endl;
+            return 1;
+        }
+        args.insert(args.begin(), mode);
+        return runHashFiles(args);
+    }
 
-int main() {
     while (true) {
         std::cout << "\n=== SHA-1 Tool ===" << std::endl;
         std::cout << "1. Hash a message" << std::endl;
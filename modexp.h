@@ -0,0 +1,707 @@
+// modexp.h
+// Modular exponentiation shared by exp7 (Diffie-Hellman), exp8 (RSA) and
+// exp10 (DSA).
+//
+// Everything that depends only on the modulus is computed once into a
+// context. Montgomery contexts (odd moduli) keep numbers as x R mod m and
+// reduce a product with multiplications by -m^-1 mod 2^64 instead of a
+// division. Barrett contexts (any modulus) reduce with a precomputed
+// reciprocal of m. Both come in a single-word form for moduli below 2^64
+// and a multi-limb form for moduli up to MAX_LIMBS limbs; larger moduli
+// fall back to plain BigInt division (DivisionN). power() runs a
+// sliding-window exponentiation on any of them; FixedBase precomputes the
+// powers of a base that never changes (DSA's g, Diffie-Hellman's G) so that
+// each exponentiation is a handful of multiplications.
+#ifndef MODEXP_H
+#define MODEXP_H
+
+#include <algorithm>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+#include "bigint.h"
+
+namespace modexp {
+
+using bigint::Limb;
+using bigint::Wide;
+
+enum Reduction { Montgomery, Barrett, Division };
+
+inline const char *reductionName(Reduction r) {
+    return r == Montgomery ? "montgomery" : r == Barrett ? "barrett" : "division";
+}
+
+// Largest modulus for MontgomeryN and BarrettN, 8192 bits; their scratch
+// space lives on the stack. Modulus switches to DivisionN above it.
+const size_t MAX_LIMBS = 128;
+
+// -m^-1 mod 2^64 for odd m: Newton's iteration doubles the correct low
+// bits each step, and m itself is right to 3 bits
+inline Limb negativeInverse(Limb m) {
+    Limb inv = m;
+    for (int i = 0; i < 5; i++) inv *= 2 - m * inv;
+    return 0 - inv;
+}
+
+// Montgomery arithmetic modulo an odd m < 2^64, R = 2^64
+class Montgomery64 {
+public:
+    typedef uint64_t Elem;
+
+    Montgomery64() {}
+
+    explicit Montgomery64(uint64_t modulus) : m(modulus), ninv(negativeInverse(modulus)) {
+        r1 = uint64_t((Wide(1) << 64) % m);
+        r2 = uint64_t(Wide(r1) * r1 % m);
+    }
+
+    Elem one() const { return r1; }
+    Elem convert(uint64_t x) const { return reduce(Wide(x % m) * r2); }
+    Elem convert(const BigInt &x) const { return convert(mod(x, BigInt::fromU64(m)).low64()); }
+    uint64_t plain(Elem x) const { return reduce(x); }
+    BigInt value(Elem x) const { return BigInt::fromU64(plain(x)); }
+
+    void mul(Elem &r, Elem a, Elem b) const { r = reduce(Wide(a) * b); }
+    void sqr(Elem &r, Elem a) const { r = reduce(Wide(a) * a); }
+
+private:
+    uint64_t m = 1, ninv = 0, r1 = 0, r2 = 0;
+
+    // t R^-1 mod m for t < m^2. t + q m is a multiple of 2^64, so its low
+    // word is 0 and only carries out of it when t's low word is not 0; the
+    // high part is below 2m and may need one subtraction.
+    uint64_t reduce(Wide t) const {
+        uint64_t q = uint64_t(t) * ninv;
+        Wide qm = Wide(q) * m;
+        Wide r = (t >> 64) + (qm >> 64) + (uint64_t(t) != 0);
+        return uint64_t(r >= m ? r - m : r);
+    }
+};
+
+// Barrett reduction modulo any 2 <= m < 2^64 with mu = floor(2^128 / m)
+class Barrett64 {
+public:
+    typedef uint64_t Elem;
+
+    Barrett64() {}
+
+    explicit Barrett64(uint64_t modulus) : m(modulus) {
+        // 2^128 / m = (2^128 - 1) / m unless m divides 2^128 (m a power of 2)
+        mu = ~Wide(0) / m + ((modulus & (modulus - 1)) == 0);
+    }
+
+    Elem one() const { return 1 % m; }
+    Elem convert(uint64_t x) const { return x % m; }
+    Elem convert(const BigInt &x) const { return mod(x, BigInt::fromU64(m)).low64(); }
+    uint64_t plain(Elem x) const { return x; }
+    BigInt value(Elem x) const { return BigInt::fromU64(x); }
+
+    void mul(Elem &r, Elem a, Elem b) const { r = reduce(Wide(a) * b); }
+    void sqr(Elem &r, Elem a) const { r = reduce(Wide(a) * a); }
+
+private:
+    uint64_t m = 2;
+    Wide mu = 0;
+
+    // q = high 128 bits of x mu is floor(x / m) or up to 2 less
+    uint64_t reduce(Wide x) const {
+        uint64_t x0 = uint64_t(x), x1 = uint64_t(x >> 64), u0 = uint64_t(mu), u1 = uint64_t(mu >> 64);
+        Wide lo = Wide(x0) * u0, mid1 = Wide(x0) * u1, mid2 = Wide(x1) * u0, hi = Wide(x1) * u1;
+        Wide middle = (lo >> 64) + uint64_t(mid1) + uint64_t(mid2);
+        Wide q = hi + (mid1 >> 64) + (mid2 >> 64) + (middle >> 64);
+        Wide r = x - q * m;
+        while (r >= m) r -= m;
+        return uint64_t(r);
+    }
+};
+
+// Montgomery arithmetic modulo an odd multi-limb m, R = 2^(64 n). Elements
+// are n-limb vectors holding x R mod m.
+class MontgomeryN {
+public:
+    typedef std::vector<Limb> Elem;
+
+    MontgomeryN() {}
+
+    explicit MontgomeryN(const BigInt &modulus)
+        : m(modulus.limbs()), n(m.size()), ninv(negativeInverse(m[0])), modulus(modulus) {
+        r2 = limbsOf(mod(BigInt(1) << (128 * n), modulus));
+        r1 = limbsOf(mod(BigInt(1) << (64 * n), modulus));
+    }
+
+    Elem one() const { return r1; }
+
+    Elem convert(const BigInt &x) const {
+        Elem r;
+        mul(r, limbsOf(mod(x, modulus)), r2);
+        return r;
+    }
+
+    BigInt value(const Elem &x) const {
+        Elem unit(n, 0), r;
+        unit[0] = 1;
+        mul(r, x, unit);
+        return BigInt::fromLimbs(r.data(), n);
+    }
+
+    // Interleaved product: for each limb b[i], t += a b[i] + q m with q
+    // chosen to clear t's lowest limb, then t drops that limb. Both
+    // multiply-adds run in the same pass over t. t stays below 2m, so the
+    // result takes at most one subtraction.
+    void mul(Elem &r, const Elem &a, const Elem &b) const {
+        Limb t[MAX_LIMBS + 1];
+        std::fill(t, t + n + 1, 0);
+        const Limb *ap = a.data(), *mp = m.data();
+        for (size_t i = 0; i < n; i++) {
+            Limb bi = b[i];
+            Wide s = Wide(ap[0]) * bi + t[0];
+            Limb low = Limb(s), c1 = Limb(s >> 64);
+            Limb q = low * ninv;
+            Limb c2 = Limb((Wide(mp[0]) * q + low) >> 64);
+            for (size_t j = 1; j < n; j++) {
+                s = Wide(ap[j]) * bi + t[j] + c1;
+                c1 = Limb(s >> 64);
+                Wide u = Wide(mp[j]) * q + Limb(s) + c2;
+                c2 = Limb(u >> 64);
+                t[j - 1] = Limb(u);
+            }
+            s = Wide(t[n]) + c1 + c2;
+            t[n - 1] = Limb(s);
+            t[n] = Limb(s >> 64);
+        }
+        if (t[n] || bigint::compare(t, mp, n) >= 0) bigint::sub(t, t, mp, n);
+        r.assign(t, t + n);
+    }
+
+    // Squares are most of an exponentiation, so they get their own path:
+    // each cross product a[i] a[j] is computed once and doubled, then the
+    // 2n-limb square is reduced one limb at a time as in mul()
+    void sqr(Elem &r, const Elem &a) const {
+        Limb x[2 * MAX_LIMBS + 1];
+        const Limb *mp = m.data();
+        bigint::sqrSchoolbook(x, a.data(), n);
+        x[2 * n] = 0;
+        for (size_t i = 0; i < n; i++) {
+            Limb c = bigint::mulAdd(x + i, mp, n, x[i] * ninv);
+            bigint::addLimb(x + i + n, n + 1 - i, c);
+        }
+        Limb *high = x + n;
+        if (high[n] || bigint::compare(high, mp, n) >= 0) bigint::sub(high, high, mp, n);
+        r.assign(high, high + n);
+    }
+
+private:
+    std::vector<Limb> m;
+    size_t n = 0;
+    Limb ninv = 0;
+    BigInt modulus;
+    Elem r1, r2;
+
+    Elem limbsOf(const BigInt &x) const {
+        Elem e(n, 0);
+        std::copy(x.limbs().begin(), x.limbs().end(), e.begin());
+        return e;
+    }
+};
+
+// Barrett reduction modulo any multi-limb m (n limbs): with
+// mu = floor(B^2n / m), q = ((x / B^(n-1)) mu) / B^(n+1) is at most 2 below
+// floor(x / m), so x - q m needs at most two subtractions of m.
+class BarrettN {
+public:
+    typedef std::vector<Limb> Elem;
+
+    BarrettN() {}
+
+    explicit BarrettN(const BigInt &modulus) : m(modulus.limbs()), n(m.size()), modulus(modulus) {
+        // n + 1 limbs, or n + 2 when m is exactly B^(n-1) and mu = B^(n+1)
+        BigInt reciprocal = (BigInt(1) << (128 * n)) / modulus;
+        mu.assign(std::max(n + 1, reciprocal.limbCount()), 0);
+        std::copy(reciprocal.limbs().begin(), reciprocal.limbs().end(), mu.begin());
+    }
+
+    Elem one() const { return limbsOf(mod(BigInt(1), modulus)); }
+    Elem convert(const BigInt &x) const { return limbsOf(mod(x, modulus)); }
+    BigInt value(const Elem &x) const { return BigInt::fromLimbs(x.data(), n); }
+
+    // Unlike Montgomery's interleaved pass, the full product comes first
+    // here, so large moduli can take it by Karatsuba
+    void mul(Elem &r, const Elem &a, const Elem &b) const {
+        Limb x[2 * MAX_LIMBS];
+        if (n >= bigint::KARATSUBA_THRESHOLD) {
+            Limb scratch[6 * MAX_LIMBS + 512];
+            bigint::mulKaratsuba(x, a.data(), b.data(), n, scratch);
+        } else {
+            bigint::mulSchoolbook(x, a.data(), n, b.data(), n);
+        }
+        reduce(r, x);
+    }
+
+    void sqr(Elem &r, const Elem &a) const {
+        Limb x[2 * MAX_LIMBS];
+        bigint::sqrSchoolbook(x, a.data(), n);
+        reduce(r, x);
+    }
+
+private:
+    std::vector<Limb> m, mu;
+    size_t n = 0;
+    BigInt modulus;
+
+    Elem limbsOf(const BigInt &x) const {
+        Elem e(n, 0);
+        std::copy(x.limbs().begin(), x.limbs().end(), e.begin());
+        return e;
+    }
+
+    // r = x mod m for x < m^2 (2n limbs). Only two partial products are
+    // formed: q1 = x / B^(n-1) times mu in the columns from n - 1 up (the
+    // dropped columns add up to less than one unit of column n + 1, where
+    // q3 starts, so q3 is at most one lower again), and the low n + 1 limbs
+    // of q3 m, since x - q3 m < 4m fits in n + 1 limbs.
+    void reduce(Elem &r, const Limb *x) const {
+        Limb q2[2 * MAX_LIMBS + 3], qm[MAX_LIMBS + 1], rem[MAX_LIMBS + 1], mod1[MAX_LIMBS + 1];
+        const Limb *q1 = x + n - 1;
+        size_t un = mu.size();
+        std::fill(q2, q2 + n + 1 + un, 0);
+        for (size_t i = 0; i <= n; i++) {
+            size_t j = i + 1 < n ? n - 1 - i : 0;
+            q2[i + un] = bigint::mulAdd(q2 + i + j, mu.data() + j, un - j, q1[i]);
+        }
+        const Limb *q3 = q2 + n + 1;
+        std::fill(qm, qm + n + 1, 0);
+        for (size_t i = 0; i <= n; i++) {
+            size_t len = std::min(n, n + 1 - i);
+            Limb carry = bigint::mulAdd(qm + i, m.data(), len, q3[i]);
+            if (i + len <= n) qm[i + len] += carry;
+        }
+        bigint::sub(rem, x, qm, n + 1);
+        std::copy(m.begin(), m.end(), mod1);
+        mod1[n] = 0;
+        while (bigint::compare(rem, mod1, n + 1) >= 0) bigint::sub(rem, rem, mod1, n + 1);
+        r.assign(rem, rem + n);
+    }
+};
+
+// Any modulus, one BigInt product and division per multiplication: slower
+// than the contexts above but not limited to MAX_LIMBS
+class DivisionN {
+public:
+    typedef BigInt Elem;
+
+    DivisionN() {}
+
+    explicit DivisionN(const BigInt &modulus) : modulus(modulus) {}
+
+    Elem one() const { return mod(BigInt(1), modulus); }
+    Elem convert(const BigInt &x) const { return mod(x, modulus); }
+    BigInt value(const Elem &x) const { return x; }
+
+    void mul(Elem &r, const Elem &a, const Elem &b) const { r = a * b % modulus; }
+    void sqr(Elem &r, const Elem &a) const { r = a * a % modulus; }
+
+private:
+    BigInt modulus;
+};
+
+inline size_t bitLength(uint64_t e) { return e ? 64 - __builtin_clzll(e) : 0; }
+inline bool testBit(uint64_t e, size_t i) { return i < 64 && (e >> i & 1); }
+inline size_t bitLength(const BigInt &e) { return e.bitLength(); }
+inline bool testBit(const BigInt &e, size_t i) { return e.testBit(i); }
+
+// The w bits of e from bit `pos` up (w < 32)
+inline unsigned bitsAt(uint64_t e, size_t pos, int w) {
+    return pos < 64 ? unsigned(e >> pos) & ((1u << w) - 1) : 0;
+}
+
+inline unsigned bitsAt(const BigInt &e, size_t pos, int w) {
+    const std::vector<Limb> &limbs = e.limbs();
+    size_t i = pos / 64, shift = pos % 64;
+    if (i >= limbs.size()) return 0;
+    uint64_t v = limbs[i] >> shift;
+    if (shift + w > 64 && i + 1 < limbs.size()) v |= limbs[i + 1] << (64 - shift);
+    return unsigned(v) & ((1u << w) - 1);
+}
+
+// Window size that minimises squarings plus multiplications (including
+// the 2^(k-1) table entries) for an exponent of this many bits
+inline int windowFor(size_t bits) {
+    return bits <= 8 ? 1 : bits <= 24 ? 2 : bits <= 80 ? 3 : bits <= 240 ? 4 : bits <= 672 ? 5 : 6;
+}
+
+// The odd powers base, base^3, ..., base^(2^width - 1), `stride` elements
+// apart: a table built for one call, or the first row of a FixedBaseTable
+// (which holds every power, so the odd ones are 2 apart)
+template <typename Elem>
+struct OddPowers {
+    const Elem *table;
+    size_t stride;
+    int width;
+
+    const Elem &operator[](unsigned value) const { return table[(value >> 1) * stride]; }
+};
+
+// Odd powers of base up to 2^k - 1 into odd[0 .. 2^(k-1))
+template <typename Ctx>
+OddPowers<typename Ctx::Elem> oddPowers(const Ctx &ctx, const typename Ctx::Elem &base, int k,
+                                        typename Ctx::Elem *odd) {
+    typename Ctx::Elem square;
+    odd[0] = base;
+    if (k > 1) {
+        ctx.sqr(square, base);
+        for (int i = 1; i < 1 << (k - 1); i++) ctx.mul(odd[i], odd[i - 1], square);
+    }
+    return {odd, 1, k};
+}
+
+// base^exp with a sliding window of up to k bits (k = 1..6, 0 to pick by
+// size). The odd powers base, base^3, ..., base^(2^k - 1) are computed
+// first; the exponent is then read from the top, each zero bit costing one
+// squaring and each window (which starts and ends with a 1) its length in
+// squarings plus one multiplication by a table entry.
+template <typename Ctx, typename Exponent>
+typename Ctx::Elem power(const Ctx &ctx, const typename Ctx::Elem &base, const Exponent &exp, int window = 0) {
+    typedef typename Ctx::Elem Elem;
+    size_t bits = bitLength(exp);
+    if (bits == 0) return ctx.one();
+    int k = window > 0 ? std::min(window, 6) : windowFor(bits);
+
+    Elem odd[32];
+    oddPowers(ctx, base, k, odd);
+
+    Elem r = ctx.one();
+    bool started = false;
+    for (size_t i = bits; i-- > 0;) {
+        if (!testBit(exp, i)) {
+            ctx.sqr(r, r);
+            continue;
+        }
+        size_t low = i + 1 >= size_t(k) ? i + 1 - k : 0;
+        while (!testBit(exp, low)) low++;
+        unsigned value = 0;
+        for (size_t j = i + 1; j-- > low;) value = value << 1 | testBit(exp, j);
+        if (started) {
+            for (size_t j = low; j <= i; j++) ctx.sqr(r, r);
+            ctx.mul(r, r, odd[value >> 1]);
+        } else {
+            r = odd[value >> 1];
+            started = true;
+        }
+        i = low;
+    }
+    return r;
+}
+
+// A sliding window of an exponent: its odd value and its lowest bit
+struct Window {
+    size_t low;
+    unsigned value;
+};
+
+// The windows of exp from the top, as power() reads them
+template <typename Exponent>
+void slidingWindows(const Exponent &exp, int k, std::vector<Window> &out) {
+    out.clear();
+    for (size_t i = bitLength(exp); i-- > 0;) {
+        if (!testBit(exp, i)) continue;
+        size_t low = i + 1 >= size_t(k) ? i + 1 - k : 0;
+        while (!testBit(exp, low)) low++;
+        unsigned value = 0;
+        for (size_t j = i + 1; j-- > low;) value = value << 1 | testBit(exp, j);
+        out.push_back({low, value});
+        i = low;
+    }
+}
+
+// a^ea b^eb in one chain of squarings (Straus, "Shamir's trick" with
+// windows): both exponents are cut into sliding windows of their own
+// width, and each window's odd power is multiplied in at its lowest bit,
+// so the pair costs the squarings of the longer exponent once
+template <typename Ctx, typename E1, typename E2>
+typename Ctx::Elem power2(const Ctx &ctx, const OddPowers<typename Ctx::Elem> &a, const E1 &ea,
+                          const OddPowers<typename Ctx::Elem> &b, const E2 &eb) {
+    typedef typename Ctx::Elem Elem;
+    std::vector<Window> wa, wb;
+    slidingWindows(ea, a.width, wa);
+    slidingWindows(eb, b.width, wb);
+    size_t bits = std::max(bitLength(ea), bitLength(eb)), ia = 0, ib = 0;
+    Elem r = ctx.one();
+    bool started = false;
+    auto take = [&](const Elem &x) {
+        if (started) {
+            ctx.mul(r, r, x);
+        } else {
+            r = x;
+            started = true;
+        }
+    };
+    for (size_t i = bits; i-- > 0;) {
+        if (started) ctx.sqr(r, r);
+        if (ia < wa.size() && wa[ia].low == i) take(a[wa[ia++].value]);
+        if (ib < wb.size() && wb[ib].low == i) take(b[wb[ib++].value]);
+    }
+    return r;
+}
+
+// a^ea b^eb with both odd-power tables built here (window 0 picks the
+// width from the longer exponent)
+template <typename Ctx, typename E1, typename E2>
+typename Ctx::Elem power2(const Ctx &ctx, const typename Ctx::Elem &a, const E1 &ea, const typename Ctx::Elem &b,
+                          const E2 &eb, int window = 0) {
+    int k = window > 0 ? std::min(window, 6) : windowFor(std::max(bitLength(ea), bitLength(eb)));
+    typename Ctx::Elem oddA[32], oddB[32];
+    return power2(ctx, oddPowers(ctx, a, k, oddA), ea, oddPowers(ctx, b, k, oddB), eb);
+}
+
+// A modulus with its reduction context, built once and reused for every
+// exponentiation. Montgomery needs an odd modulus; an even one always gets
+// Barrett. Moduli below 2^64 use the single-word contexts, moduli past
+// MAX_LIMBS limbs always use division.
+class Modulus {
+public:
+    Modulus() {}
+
+    explicit Modulus(const BigInt &modulus, Reduction preferred = Montgomery) : m(modulus) {
+        if (modulus.limbCount() > MAX_LIMBS || preferred == Division) kind = Division;
+        else kind = modulus.isOdd() ? preferred : Barrett;
+        small = modulus.limbCount() <= 1 && kind != Division;
+        if (kind == Division) divisionN = DivisionN(modulus);
+        else if (small && kind == Montgomery) mont64 = Montgomery64(modulus.low64());
+        else if (small) barrett64 = Barrett64(modulus.low64());
+        else if (kind == Montgomery) montN = MontgomeryN(modulus);
+        else barrettN = BarrettN(modulus);
+    }
+
+    const BigInt &value() const { return m; }
+    Reduction reduction() const { return kind; }
+
+    // fn(context) with whichever context this modulus uses
+    template <typename Fn>
+    auto visit(Fn fn) const {
+        if (kind == Division) return fn(divisionN);
+        if (small && kind == Montgomery) return fn(mont64);
+        if (small) return fn(barrett64);
+        if (kind == Montgomery) return fn(montN);
+        return fn(barrettN);
+    }
+
+    // base^exp mod m for exp >= 0
+    BigInt pow(const BigInt &base, const BigInt &exp, int window = 0) const {
+        if (m == 1) return 0;
+        return visit([&](const auto &ctx) { return ctx.value(power(ctx, ctx.convert(base), exp, window)); });
+    }
+
+    // a^ea b^eb mod m in one squaring chain (power2)
+    BigInt pow2(const BigInt &a, const BigInt &ea, const BigInt &b, const BigInt &eb, int window = 0) const {
+        if (m == 1) return 0;
+        return visit([&](const auto &ctx) {
+            return ctx.value(power2(ctx, ctx.convert(a), ea, ctx.convert(b), eb, window));
+        });
+    }
+
+private:
+    BigInt m;
+    Reduction kind = Barrett;
+    bool small = true;
+    Montgomery64 mont64;
+    Barrett64 barrett64;
+    MontgomeryN montN;
+    BarrettN barrettN;
+    DivisionN divisionN;
+};
+
+// Largest fixed-base window; the table doubles with every extra bit
+const int MAX_FIXED_WIDTH = 12;
+
+// Default fixed-base window: 6 bits is about 1 MB of table for a 256-bit
+// exponent and a 2048-bit modulus
+const int FIXED_WIDTH = 6;
+
+// Powers of one base for exponents up to maxBits bits, by fixed windows
+// (Brickell et al.): entry (i, d) is base^(d 2^(w i)) for every window
+// position i and nonzero w-bit digit d, so base^e is one multiplication
+// per nonzero digit of e and no squarings at all. The table holds
+// ceil(maxBits / w) (2^w - 1) elements; w trades its size for speed.
+template <typename Ctx>
+class FixedBaseTable {
+public:
+    typedef typename Ctx::Elem Elem;
+
+    void build(const Ctx &ctx, const Elem &base, size_t maxBits, int w) {
+        width = w;
+        positions = (maxBits + w - 1) / w;
+        size_t row = (size_t(1) << w) - 1;
+        entries.assign(positions * row, Elem());
+        Elem b = base;
+        for (size_t i = 0; i < positions; i++) {
+            Elem *e = &entries[i * row];
+            e[0] = b;
+            for (size_t d = 1; d < row; d++) ctx.mul(e[d], e[d - 1], b);
+            ctx.mul(b, e[row - 1], b); // base^(2^(w (i + 1)))
+        }
+    }
+
+    // base^exp; exponents past maxBits fall back to a sliding window
+    template <typename Exponent>
+    Elem power(const Ctx &ctx, const Exponent &exp) const {
+        Elem r = ctx.one();
+        multiplyPower(ctx, r, exp, false);
+        return r;
+    }
+
+    // r = r base^exp; started = false treats r as 1 and overwrites it
+    template <typename Exponent>
+    void multiplyPower(const Ctx &ctx, Elem &r, const Exponent &exp, bool started = true) const {
+        if (bitLength(exp) > positions * width) {
+            Elem x = modexp::power(ctx, entries[0], exp);
+            if (started) ctx.mul(r, r, x);
+            else r = x;
+            return;
+        }
+        size_t row = (size_t(1) << width) - 1;
+        for (size_t i = 0; i < positions; i++) {
+            unsigned d = bitsAt(exp, i * width, width);
+            if (d == 0) continue;
+            if (started) {
+                ctx.mul(r, r, entries[i * row + d - 1]);
+            } else {
+                r = entries[i * row + d - 1];
+                started = true;
+            }
+        }
+    }
+
+    // base, base^2, ..., base^(2^width - 1) are the first row, so the odd
+    // powers for a sliding window of this width come for free
+    OddPowers<Elem> oddPowers() const { return {entries.data(), 2, width}; }
+
+    size_t size() const { return entries.size(); }
+
+private:
+    int width = 1;
+    size_t positions = 0;
+    std::vector<Elem> entries; // positions rows of 2^width - 1
+};
+
+// A fixed base modulo a Modulus with its table, for the g of DSA and the G
+// of Diffie-Hellman: built once per (base, modulus) and then used for every
+// exponent below 2^maxBits
+class FixedBase {
+public:
+    FixedBase() {}
+
+    FixedBase(const Modulus &modulus, const BigInt &base, size_t maxBits, int width = FIXED_WIDTH)
+        : m(modulus), w(std::max(1, std::min(width, MAX_FIXED_WIDTH))) {
+        m.visit([&](const auto &ctx) {
+            table(ctx).build(ctx, ctx.convert(base), std::max<size_t>(maxBits, 1), w);
+            return 0;
+        });
+    }
+
+    // base^exp mod m for exp >= 0
+    BigInt pow(const BigInt &exp) const {
+        if (m.value() == 1) return 0;
+        return m.visit([&](const auto &ctx) { return ctx.value(table(ctx).power(ctx, exp)); });
+    }
+
+    // base^e1 h^e2 mod m for another base h. base's windows run in the
+    // same squaring chain as h's (power2), with base's odd powers read from
+    // the first row of its table, which allows windows of the full table
+    // width at no cost.
+    BigInt powTimes(const BigInt &e1, const BigInt &h, const BigInt &e2) const {
+        if (m.value() == 1) return 0;
+        return m.visit([&](const auto &ctx) {
+            typename std::decay_t<decltype(ctx)>::Elem odd[32];
+            int k = windowFor(bitLength(e2));
+            return ctx.value(power2(ctx, table(ctx).oddPowers(), e1, oddPowers(ctx, ctx.convert(h), k, odd), e2));
+        });
+    }
+
+    // base^e1 h^e2 mod m when h has a table of its own (same modulus):
+    // no squarings at all, one multiplication per nonzero digit of each
+    BigInt powTimes(const BigInt &e1, const FixedBase &h, const BigInt &e2) const {
+        if (m.value() == 1) return 0;
+        return m.visit([&](const auto &ctx) {
+            auto r = h.table(ctx).power(ctx, e2);
+            table(ctx).multiplyPower(ctx, r, e1);
+            return ctx.value(r);
+        });
+    }
+
+    const Modulus &modulus() const { return m; }
+    int width() const { return w; }
+
+    // Table size in bytes (elements only)
+    size_t bytes() const {
+        return m.visit([&](const auto &ctx) {
+            return table(ctx).size() * std::max<size_t>(8, m.value().limbCount() * sizeof(Limb));
+        });
+    }
+
+private:
+    Modulus m;
+    int w = FIXED_WIDTH;
+    FixedBaseTable<Montgomery64> mont64;
+    FixedBaseTable<Barrett64> barrett64;
+    FixedBaseTable<MontgomeryN> montN;
+    FixedBaseTable<BarrettN> barrettN;
+    FixedBaseTable<DivisionN> divisionN;
+
+    FixedBaseTable<Montgomery64> &table(const Montgomery64 &) { return mont64; }
+    FixedBaseTable<Barrett64> &table(const Barrett64 &) { return barrett64; }
+    FixedBaseTable<MontgomeryN> &table(const MontgomeryN &) { return montN; }
+    FixedBaseTable<BarrettN> &table(const BarrettN &) { return barrettN; }
+    FixedBaseTable<DivisionN> &table(const DivisionN &) { return divisionN; }
+    const FixedBaseTable<Montgomery64> &table(const Montgomery64 &) const { return mont64; }
+    const FixedBaseTable<Barrett64> &table(const Barrett64 &) const { return barrett64; }
+    const FixedBaseTable<MontgomeryN> &table(const MontgomeryN &) const { return montN; }
+    const FixedBaseTable<BarrettN> &table(const BarrettN &) const { return barrettN; }
+    const FixedBaseTable<DivisionN> &table(const DivisionN &) const { return divisionN; }
+};
+
+inline BigInt gcd(BigInt a, BigInt b) {
+    a = a.abs();
+    b = b.abs();
+    while (!b.isZero()) {
+        BigInt r = a % b;
+        a = std::move(b);
+        b = std::move(r);
+    }
+    return a;
+}
+
+// a^-1 mod m in [0, m) by the extended Euclidean algorithm; 0 if a and m
+// are not coprime
+inline BigInt inverse(const BigInt &a, const BigInt &m) {
+    BigInt r0 = m, r1 = mod(a, m), s0 = 0, s1 = 1;
+    while (!r1.isZero()) {
+        BigInt q, r;
+        BigInt::divMod(r0, r1, q, r);
+        r0 = std::move(r1);
+        r1 = std::move(r);
+        BigInt s = s0 - q * s1;
+        s0 = std::move(s1);
+        s1 = std::move(s);
+    }
+    return r0 == 1 ? mod(s0, m) : BigInt(0);
+}
+
+// One-off base^exp mod m (m > 0); keep a Modulus to reuse the context
+inline BigInt powMod(const BigInt &base, const BigInt &exp, const BigInt &m, Reduction reduction = Montgomery) {
+    return Modulus(m, reduction).pow(base, exp);
+}
+
+inline uint64_t powMod(uint64_t base, uint64_t exp, uint64_t m, Reduction reduction = Montgomery) {
+    if (m == 1) return 0;
+    if (reduction == Montgomery && (m & 1)) {
+        Montgomery64 ctx(m);
+        return ctx.plain(power(ctx, ctx.convert(base), exp));
+    }
+    Barrett64 ctx(m);
+    return ctx.plain(power(ctx, ctx.convert(base), exp));
+}
+
+} // namespace modexp
+
+#endif
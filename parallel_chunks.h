@@ -0,0 +1,141 @@
+// parallel_chunks.h
+// Chunked parallel driver for the stateless ciphers (exp1 Caesar, exp2
+// monoalphabetic, exp5 Hill). Their output for a byte range depends only on
+// that range, so the input is cut into cache-sized chunks that a small
+// thread pool transforms in place. Output order is kept because every chunk
+// writes back to the offsets it was read from. The same pool also hands out
+// other independent jobs: key ranges (exp6) and whole files (exp9).
+#ifndef PARALLEL_CHUNKS_H
+#define PARALLEL_CHUNKS_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Default chunk: small enough to stay in a core's L2 cache
+const size_t PARALLEL_CHUNK_SIZE = 256 << 10;
+
+class ChunkPool {
+public:
+    // threads counts the calling thread too; 0 means one per hardware thread
+    explicit ChunkPool(unsigned threads = 0) {
+        if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+        for (unsigned i = 1; i < threads; i++)
+            workers.emplace_back([this] { workerLoop(); });
+    }
+
+    ~ChunkPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread &t : workers) t.join();
+    }
+
+    ChunkPool(const ChunkPool &) = delete;
+    ChunkPool &operator=(const ChunkPool &) = delete;
+
+    unsigned size() const { return unsigned(workers.size()) + 1; }
+
+    // Pool shared by everything in the process that does not bring its own
+    static ChunkPool &shared() {
+        static ChunkPool pool;
+        return pool;
+    }
+
+    // Call fn(begin, end) for consecutive chunks covering [0, total) and
+    // wait for all of them. Chunk boundaries are multiples of align, so a
+    // block cipher never sees a block split between two chunks.
+    void run(size_t total, size_t chunkSize, size_t align, const std::function<void(size_t, size_t)> &fn) {
+        if (align == 0) align = 1;
+        chunkSize = std::max(align, chunkSize / align * align);
+        if (workers.empty() || total <= chunkSize) {
+            for (size_t b = 0; b < total; b += chunkSize) fn(b, std::min(total, b + chunkSize));
+            return;
+        }
+
+        std::lock_guard<std::mutex> oneJobAtATime(runMutex);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job = &fn;
+            jobTotal = total;
+            jobChunk = chunkSize;
+            next = 0;
+            active = unsigned(workers.size());
+            generation++;
+        }
+        wake.notify_all();
+        drain();
+
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this] { return active == 0; });
+        job = nullptr;
+    }
+
+private:
+    std::vector<std::thread> workers;
+    std::mutex mutex, runMutex;
+    std::condition_variable wake, done;
+    bool stopping = false;
+    unsigned long generation = 0;
+    unsigned active = 0;
+
+    const std::function<void(size_t, size_t)> *job = nullptr;
+    size_t jobTotal = 0, jobChunk = 0;
+    std::atomic<size_t> next{0};
+
+    // Take chunks until none are left
+    void drain() {
+        size_t i;
+        while ((i = next.fetch_add(1)) < (jobTotal + jobChunk - 1) / jobChunk) {
+            size_t b = i * jobChunk;
+            (*job)(b, std::min(jobTotal, b + jobChunk));
+        }
+    }
+
+    void workerLoop() {
+        unsigned long seen = 0;
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&] { return stopping || generation != seen; });
+                if (stopping) return;
+                seen = generation;
+            }
+            drain();
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--active == 0) done.notify_all();
+        }
+    }
+};
+
+// Thread counts for scaling benchmarks: 1, 2, 4, ... and the core count
+inline std::vector<unsigned> scalingThreadCounts() {
+    unsigned maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<unsigned> counts;
+    for (unsigned t = 1; t < maxThreads; t *= 2) counts.push_back(t);
+    counts.push_back(maxThreads);
+    return counts;
+}
+
+// Stream in to out through one reusable batch buffer (a few chunks per
+// thread). Each batch is transformed in place by fn(data, len) on the pool
+// and written out before the next one is read. Returns false on I/O errors.
+inline bool streamChunks(FILE *in, FILE *out, ChunkPool &pool, size_t chunkSize,
+                         const std::function<void(char *, size_t)> &fn) {
+    std::vector<char> batch(chunkSize * pool.size() * 4);
+    size_t n;
+    while ((n = fread(batch.data(), 1, batch.size(), in)) > 0) {
+        pool.run(n, chunkSize, 1, [&](size_t b, size_t e) { fn(batch.data() + b, e - b); });
+        if (fwrite(batch.data(), 1, n, out) != n) return false;
+    }
+    return !ferror(in) && fflush(out) == 0;
+}
+
+#endif
@@ -0,0 +1,303 @@
+// primes.h
+// Prime testing and generation for key setup (exp8 RSA, exp10 DSA).
+//
+// A candidate first meets a table of the odd primes below 2^16: a few
+// hundred of them as plain trial division when a single number is tested,
+// all of them as a sieve over a window of candidates when searching. What
+// survives goes to Miller-Rabin: deterministic bases below 2^64 and random
+// bases above, with the round count set by the size. A search runs one
+// window per thread from independent random starting points; a window that
+// yields nothing is slid forward by updating its residues instead of
+// recomputing them, and every thread stops once any of them has a prime.
+#ifndef PRIMES_H
+#define PRIMES_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <random>
+#include <vector>
+#include "bigint.h"
+#include "modexp.h"
+#include "parallel_chunks.h"
+
+namespace primes {
+
+using bigint::Limb;
+using bigint::Wide;
+
+const uint32_t SMALL_PRIME_LIMIT = 1 << 16;
+
+// Trial division in isProbablePrime stops at primes below this
+const uint32_t TRIAL_DIVISION_LIMIT = 2048;
+
+// The odd primes below SMALL_PRIME_LIMIT, and the same primes multiplied
+// together in groups whose product fits in 64 bits: a big number is
+// reduced once per group (one pass over its limbs), and each prime's
+// residue then comes from that 64-bit remainder.
+struct SmallPrimeTable {
+    std::vector<uint32_t> primes;
+    std::vector<uint64_t> groupProduct;
+    std::vector<size_t> groupEnd; // index in primes after each group
+
+    SmallPrimeTable() {
+        std::vector<char> composite(SMALL_PRIME_LIMIT);
+        for (uint32_t i = 3; i < SMALL_PRIME_LIMIT; i += 2) {
+            if (composite[i]) continue;
+            primes.push_back(i);
+            for (uint64_t j = uint64_t(i) * i; j < SMALL_PRIME_LIMIT; j += 2 * i) composite[j] = 1;
+        }
+        uint64_t product = 1;
+        for (size_t i = 0; i < primes.size(); i++) {
+            if (Wide(product) * primes[i] >> 64) {
+                groupProduct.push_back(product);
+                groupEnd.push_back(i);
+                product = 1;
+            }
+            product *= primes[i];
+        }
+        groupProduct.push_back(product);
+        groupEnd.push_back(primes.size());
+    }
+};
+
+inline const SmallPrimeTable &smallPrimes() {
+    static const SmallPrimeTable table;
+    return table;
+}
+
+// x mod d for d < 2^64, one limb at a time from the top
+inline uint64_t modSmall(const BigInt &x, uint64_t d) {
+    Wide r = 0;
+    const std::vector<Limb> &limbs = x.limbs();
+    for (size_t i = limbs.size(); i-- > 0;) r = ((r << 64) | limbs[i]) % d;
+    return uint64_t(r);
+}
+
+// x mod p for the first `count` small primes (x >= 0)
+inline void smallResidues(const BigInt &x, size_t count, std::vector<uint32_t> &out) {
+    const SmallPrimeTable &t = smallPrimes();
+    out.resize(count);
+    size_t begin = 0;
+    for (size_t g = 0; begin < count; begin = t.groupEnd[g++]) {
+        uint64_t r = modSmall(x, t.groupProduct[g]);
+        for (size_t i = begin; i < t.groupEnd[g] && i < count; i++) out[i] = uint32_t(r % t.primes[i]);
+    }
+}
+
+// Rounds for an error below 2^-100 on random candidates, in the spirit of
+// FIPS 186-4 table C.2; small sizes get the adversarial-input count
+inline int roundsFor(size_t bits) {
+    return bits >= 1536 ? 3 : bits >= 1024 ? 4 : bits >= 512 ? 7 : 40;
+}
+
+// One Miller-Rabin round: n - 1 = d 2^s with d odd, and n passes for base
+// a if a^d is 1 or reaches n - 1 within s - 1 squarings
+template <typename Ctx>
+bool millerRabin(const Ctx &ctx, const typename Ctx::Elem &a, const BigInt &d, size_t s,
+                 const typename Ctx::Elem &minusOne) {
+    typename Ctx::Elem x = modexp::power(ctx, a, d);
+    if (x == ctx.one() || x == minusOne) return true;
+    for (size_t i = 1; i < s; i++) {
+        ctx.sqr(x, x);
+        if (x == minusOne) return true;
+        if (x == ctx.one()) return false;
+    }
+    return false;
+}
+
+// Deterministic below 2^64: the first twelve primes as bases leave no
+// strong pseudoprime under 3.3 * 10^24
+inline bool isPrime64(uint64_t n) {
+    static const uint32_t bases[] = {2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37};
+    if (n < 2) return false;
+    for (uint32_t p : bases)
+        if (n % p == 0) return n == p;
+    uint64_t d = n - 1;
+    size_t s = __builtin_ctzll(d);
+    d >>= s;
+    modexp::Montgomery64 ctx(n);
+    uint64_t minusOne = ctx.convert(n - 1);
+    for (uint32_t a : bases)
+        if (!millerRabin(ctx, ctx.convert(uint64_t(a)), BigInt::fromU64(d), s, minusOne)) return false;
+    return true;
+}
+
+// Miller-Rabin with `rounds` random bases from rng (0 picks the count from
+// the size) after trial division by the primes below TRIAL_DIVISION_LIMIT;
+// exact below 2^64. trialDivision = false skips the division, for
+// candidates that already came through the sieve.
+template <typename Rng>
+bool isProbablePrime(const BigInt &n, Rng &rng, int rounds = 0, bool trialDivision = true) {
+    if (n.isNegative()) return false;
+    if (n.limbCount() <= 1) return isPrime64(n.low64());
+    if (!n.isOdd()) return false;
+    if (trialDivision) {
+        const SmallPrimeTable &t = smallPrimes();
+        size_t count = std::lower_bound(t.primes.begin(), t.primes.end(), TRIAL_DIVISION_LIMIT) - t.primes.begin();
+        std::vector<uint32_t> residues;
+        smallResidues(n, count, residues);
+        for (uint32_t r : residues)
+            if (r == 0) return false;
+    }
+    if (rounds == 0) rounds = roundsFor(n.bitLength());
+
+    BigInt d = n - 1;
+    size_t s = 0;
+    while (!d.testBit(s)) s++;
+    d >>= s;
+    // Montgomery up to MAX_LIMBS limbs, plain division past it
+    return modexp::Modulus(n).visit([&](const auto &ctx) {
+        auto minusOne = ctx.convert(n - 1);
+        for (int i = 0; i < rounds; i++) {
+            // base 2 first, which rejects almost every composite on its own
+            BigInt a = i == 0 ? BigInt(2) : BigInt::random(n.bitLength() + 64, rng) % (n - 3) + 2;
+            if (!millerRabin(ctx, ctx.convert(a), d, s, minusOne)) return false;
+        }
+        return true;
+    });
+}
+
+// step^-1 mod p for every small prime p (0 where p divides step), by
+// Fermat's little theorem; computed once per search
+inline std::vector<uint32_t> stepInverses(const std::vector<uint32_t> &stepResidues) {
+    const std::vector<uint32_t> &primes = smallPrimes().primes;
+    std::vector<uint32_t> inv(stepResidues.size());
+    for (size_t j = 0; j < stepResidues.size(); j++) {
+        uint64_t p = primes[j], result = 1, base = stepResidues[j];
+        for (uint64_t e = p - 2; e; e >>= 1, base = base * base % p)
+            if (e & 1) result = result * base % p;
+        inv[j] = stepResidues[j] ? uint32_t(result) : 0;
+    }
+    return inv;
+}
+
+// Mark the candidates start + i step, i in [0, count), that have a factor
+// among the small primes (callers pass an odd start and an even step).
+// residues[j] = start mod primes[j] on entry and is moved on to
+// start + count step on return, so the next window needs no big-number
+// division.
+inline void sieveWindow(std::vector<uint32_t> &residues, const std::vector<uint32_t> &stepResidues,
+                        const std::vector<uint32_t> &inverses, size_t count, std::vector<char> &composite) {
+    const std::vector<uint32_t> &primes = smallPrimes().primes;
+    composite.assign(count, 0);
+    for (size_t j = 0; j < residues.size(); j++) {
+        uint64_t p = primes[j], r = residues[j], step = stepResidues[j];
+        residues[j] = uint32_t((r + count % p * step) % p);
+        if (step == 0) {
+            if (r == 0) composite.assign(count, 1);
+            continue;
+        }
+        // the first i with r + i step = 0 (mod p) is -r / step
+        for (uint64_t i = (p - r) % p * inverses[j] % p; i < count; i += p) composite[i] = 1;
+    }
+}
+
+// Shared by the threads of one search: the first prime found wins
+struct SearchResult {
+    std::atomic<bool> found{false};
+    std::mutex mutex;
+    BigInt prime;
+};
+
+// Search start, start + step, ... in windows of `window` candidates until
+// a probable prime turns up here or in another thread. Candidates must be
+// above SMALL_PRIME_LIMIT so a small prime never sieves itself out.
+inline void searchProgression(BigInt start, const BigInt &step, size_t window, uint64_t seed, SearchResult &result) {
+    const size_t count = smallPrimes().primes.size();
+    std::vector<uint32_t> residues, stepResidues;
+    std::vector<char> composite;
+    smallResidues(start, count, residues);
+    smallResidues(step, count, stepResidues);
+    std::vector<uint32_t> inverses = stepInverses(stepResidues);
+    std::mt19937_64 rng(seed);
+
+    while (!result.found.load(std::memory_order_relaxed)) {
+        sieveWindow(residues, stepResidues, inverses, window, composite);
+        for (size_t i = 0; i < window; i++) {
+            if (composite[i]) continue;
+            if (result.found.load(std::memory_order_relaxed)) return;
+            BigInt candidate = start + step * BigInt((long long)i);
+            if (!isProbablePrime(candidate, rng, 0, false)) continue;
+            std::lock_guard<std::mutex> lock(result.mutex);
+            if (!result.found) {
+                result.prime = candidate;
+                result.found = true;
+            }
+            return;
+        }
+        start += step * BigInt((long long)window);
+    }
+}
+
+// One search per pool thread, each from its own draw(rng) with step `step`
+template <typename Rng, typename Draw>
+BigInt parallelSearch(Draw draw, const BigInt &step, size_t window, Rng &rng, ChunkPool &pool) {
+    std::vector<BigInt> starts;
+    std::vector<uint64_t> seeds;
+    for (unsigned t = 0; t < pool.size(); t++) {
+        starts.push_back(draw(rng));
+        seeds.push_back(uint64_t(rng()));
+    }
+    SearchResult result;
+    pool.run(starts.size(), 1, 1, [&](size_t b, size_t) { searchProgression(starts[b], step, window, seeds[b], result); });
+    return result.prime;
+}
+
+// A random prime of exactly `bits` bits (bits > 16) with the top two bits
+// set, so the product of two of them has exactly 2 bits bits
+template <typename Rng>
+BigInt randomPrime(size_t bits, Rng &rng, ChunkPool &pool = ChunkPool::shared()) {
+    // Long enough that the window rarely runs dry (primes near 2^bits are
+    // about 0.7 bits apart) without sieving much past the first hit
+    size_t window = 2 * bits;
+    auto draw = [bits](Rng &r) {
+        BigInt x = BigInt::random(bits - 2, r) + (BigInt(3) << (bits - 2));
+        return x.isOdd() ? x : x + 1;
+    };
+    // A search that started just below 2^bits can run past it
+    BigInt p;
+    do p = parallelSearch(draw, BigInt(2), window, rng, pool);
+    while (p.bitLength() != bits);
+    return p;
+}
+
+// A random prime of exactly `bits` bits with p = 1 (mod m), for an even m
+// well below 2^bits: the DSA modulus p = k q + 1 is searched along m = 2q
+template <typename Rng>
+BigInt randomPrimeOneMod(size_t bits, const BigInt &m, Rng &rng, ChunkPool &pool = ChunkPool::shared()) {
+    // All candidates are odd, so about one in 0.35 bits is prime, as for
+    // randomPrime (a little more often when m has small odd factors)
+    size_t window = 2 * bits;
+    auto draw = [bits, &m](Rng &r) {
+        BigInt x = BigInt::random(bits - 1, r) + (BigInt(1) << (bits - 1));
+        return x - x % m + 1;
+    };
+    BigInt p;
+    do p = parallelSearch(draw, m, window, rng, pool);
+    while (p.bitLength() != bits);
+    return p;
+}
+
+// Smallest prime >= n
+template <typename Rng>
+BigInt nextPrime(const BigInt &n, Rng &rng) {
+    BigInt x = n < 2 ? BigInt(2) : n;
+    if (x == 2) return x;
+    if (!x.isOdd()) x += 1;
+    while (!isProbablePrime(x, rng)) x += 2;
+    return x;
+}
+
+// 64 random bits per call from the system source, for seeding searches and
+// drawing private values
+struct SystemRandom {
+    std::random_device device;
+    typedef uint64_t result_type;
+    uint64_t operator()() { return uint64_t(device()) << 32 | device(); }
+};
+
+} // namespace primes
+
+#endif
@@ -0,0 +1,255 @@
+// shift_kernel.h
+// Branch-free letter shifting shared by exp1 (Caesar) and exp4 (Vigenere).
+//
+// Every byte is classified as upper case, lower case or "other" with compare
+// masks: (c | 0x20) - 'a' is below 26 exactly for letters, and c & 0x20
+// remembers the case. Letters are shifted mod 26 with a conditional subtract,
+// everything else is passed through unchanged. The SSE2 and AVX2 versions do
+// this 16 / 32 bytes at a time; the best one is picked at runtime.
+// shiftRunning() is the Vigenere variant that takes the key straight from
+// the repeated keyword instead of a fully expanded key.
+#ifndef SHIFT_KERNEL_H
+#define SHIFT_KERNEL_H
+
+#include <cstddef>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SHIFT_KERNEL_X86 1
+#include <immintrin.h>
+#endif
+
+namespace shiftkernel {
+
+enum Backend { Scalar, SSE2, AVX2 };
+
+inline const char *backendName(Backend b) {
+    return b == AVX2 ? "avx2" : b == SSE2 ? "sse2" : "scalar";
+}
+
+inline bool supported(Backend b) {
+#ifdef SHIFT_KERNEL_X86
+    if (b == AVX2) return __builtin_cpu_supports("avx2");
+    if (b == SSE2) return __builtin_cpu_supports("sse2");
+#endif
+    return b == Scalar;
+}
+
+inline Backend best() {
+    static const Backend chosen = supported(AVX2) ? AVX2 : supported(SSE2) ? SSE2 : Scalar;
+    return chosen;
+}
+
+// Shift amount for one key letter; decryption uses the complement
+inline unsigned keyShift(unsigned char k, bool decrypt) {
+    unsigned s = (unsigned char)((k | 0x20) - 'a');
+    return decrypt ? 26 - s : s;
+}
+
+inline unsigned char shiftByte(unsigned char c, unsigned shift) {
+    unsigned t = (unsigned char)((c | 0x20) - 'a');
+    if (t >= 26) return c;
+    unsigned v = t + shift;
+    if (v >= 26) v -= 26;
+    return (unsigned char)(('A' + v) | (c & 0x20));
+}
+
+// Scalar versions: also finish the tail the vector loops leave behind
+inline void uniformScalar(const char *in, char *out, size_t len, unsigned shift) {
+    for (size_t i = 0; i < len; i++)
+        out[i] = (char)shiftByte((unsigned char)in[i], shift);
+}
+
+inline void keyedScalar(const char *in, const char *key, char *out, size_t len, bool decrypt) {
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)in[i];
+        unsigned t = (unsigned char)((c | 0x20) - 'a');
+        out[i] = t < 26 ? (char)shiftByte(c, keyShift((unsigned char)key[i], decrypt)) : (char)c;
+    }
+}
+
+#ifdef SHIFT_KERNEL_X86
+// Shift the 16 bytes of c by the per-byte amounts in s (each in [0, 26])
+inline __m128i shift16(__m128i c, __m128i s) {
+    const __m128i caseBit = _mm_set1_epi8(0x20);
+    const __m128i n25 = _mm_set1_epi8(25), n26 = _mm_set1_epi8(26);
+    __m128i t = _mm_sub_epi8(_mm_or_si128(c, caseBit), _mm_set1_epi8('a'));
+    __m128i isLetter = _mm_cmpeq_epi8(_mm_min_epu8(t, n25), t);
+    __m128i v = _mm_add_epi8(t, s);
+    __m128i wrap = _mm_cmpeq_epi8(_mm_max_epu8(v, n26), v);
+    v = _mm_sub_epi8(v, _mm_and_si128(wrap, n26));
+    __m128i r = _mm_or_si128(_mm_add_epi8(v, _mm_set1_epi8('A')), _mm_and_si128(c, caseBit));
+    return _mm_or_si128(_mm_and_si128(isLetter, r), _mm_andnot_si128(isLetter, c));
+}
+
+inline __m128i keyShift16(__m128i k, bool decrypt) {
+    __m128i s = _mm_sub_epi8(_mm_or_si128(k, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+    return decrypt ? _mm_sub_epi8(_mm_set1_epi8(26), s) : s;
+}
+
+__attribute__((target("sse2")))
+inline void uniformSSE2(const char *in, char *out, size_t len, unsigned shift) {
+    const __m128i s = _mm_set1_epi8((char)shift);
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i c = _mm_loadu_si128((const __m128i *)(in + i));
+        _mm_storeu_si128((__m128i *)(out + i), shift16(c, s));
+    }
+    uniformScalar(in + i, out + i, len - i, shift);
+}
+
+__attribute__((target("sse2")))
+inline void keyedSSE2(const char *in, const char *key, char *out, size_t len, bool decrypt) {
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i c = _mm_loadu_si128((const __m128i *)(in + i));
+        __m128i k = _mm_loadu_si128((const __m128i *)(key + i));
+        _mm_storeu_si128((__m128i *)(out + i), shift16(c, keyShift16(k, decrypt)));
+    }
+    keyedScalar(in + i, key + i, out + i, len - i, decrypt);
+}
+
+__attribute__((target("avx2")))
+inline __m256i shift32(__m256i c, __m256i s) {
+    const __m256i caseBit = _mm256_set1_epi8(0x20);
+    const __m256i n25 = _mm256_set1_epi8(25), n26 = _mm256_set1_epi8(26);
+    __m256i t = _mm256_sub_epi8(_mm256_or_si256(c, caseBit), _mm256_set1_epi8('a'));
+    __m256i isLetter = _mm256_cmpeq_epi8(_mm256_min_epu8(t, n25), t);
+    __m256i v = _mm256_add_epi8(t, s);
+    __m256i wrap = _mm256_cmpeq_epi8(_mm256_max_epu8(v, n26), v);
+    v = _mm256_sub_epi8(v, _mm256_and_si256(wrap, n26));
+    __m256i r = _mm256_or_si256(_mm256_add_epi8(v, _mm256_set1_epi8('A')), _mm256_and_si256(c, caseBit));
+    return _mm256_blendv_epi8(c, r, isLetter);
+}
+
+__attribute__((target("avx2")))
+inline void uniformAVX2(const char *in, char *out, size_t len, unsigned shift) {
+    const __m256i s = _mm256_set1_epi8((char)shift);
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i c = _mm256_loadu_si256((const __m256i *)(in + i));
+        _mm256_storeu_si256((__m256i *)(out + i), shift32(c, s));
+    }
+    uniformSSE2(in + i, out + i, len - i, shift);
+}
+
+__attribute__((target("avx2")))
+inline void keyedAVX2(const char *in, const char *key, char *out, size_t len, bool decrypt) {
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i c = _mm256_loadu_si256((const __m256i *)(in + i));
+        __m256i k = _mm256_loadu_si256((const __m256i *)(key + i));
+        __m256i s = _mm256_sub_epi8(_mm256_or_si256(k, _mm256_set1_epi8(0x20)), _mm256_set1_epi8('a'));
+        if (decrypt) s = _mm256_sub_epi8(_mm256_set1_epi8(26), s);
+        _mm256_storeu_si256((__m256i *)(out + i), shift32(c, s));
+    }
+    keyedSSE2(in + i, key + i, out + i, len - i, decrypt);
+}
+#endif
+
+inline size_t countLettersScalar(const char *in, size_t len) {
+    size_t count = 0;
+    for (size_t i = 0; i < len; i++)
+        count += (unsigned char)((in[i] | 0x20) - 'a') < 26;
+    return count;
+}
+
+// Running key: the j-th letter of in uses key[k + j]. key must hold at
+// least k + len bytes. Returns k advanced past the letters consumed.
+inline size_t runningScalar(const char *in, char *out, size_t len, const char *key, size_t k, bool decrypt) {
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)in[i];
+        if ((unsigned char)((c | 0x20) - 'a') < 26) {
+            out[i] = (char)shiftByte(c, keyShift((unsigned char)key[k++], decrypt));
+        } else {
+            out[i] = (char)c;
+        }
+    }
+    return k;
+}
+
+#ifdef SHIFT_KERNEL_X86
+__attribute__((target("sse2")))
+inline size_t countLettersSSE2(const char *in, size_t len) {
+    __m128i sums = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i c = _mm_loadu_si128((const __m128i *)(in + i));
+        __m128i t = _mm_sub_epi8(_mm_or_si128(c, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+        __m128i isLetter = _mm_cmpeq_epi8(_mm_min_epu8(t, _mm_set1_epi8(25)), t);
+        sums = _mm_add_epi64(sums, _mm_sad_epu8(_mm_and_si128(isLetter, _mm_set1_epi8(1)), _mm_setzero_si128()));
+    }
+    unsigned long long lanes[2];
+    _mm_storeu_si128((__m128i *)lanes, sums);
+    return (size_t)(lanes[0] + lanes[1]) + countLettersScalar(in + i, len - i);
+}
+
+// The key index of each letter is k plus the number of letters before it
+// in the 16-byte block: a byte-wise prefix sum of the letter mask. Those
+// offsets are at most 15, so one pshufb gathers the key bytes.
+__attribute__((target("ssse3")))
+inline size_t runningSSSE3(const char *in, char *out, size_t len, const char *key, size_t k, bool decrypt) {
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i c = _mm_loadu_si128((const __m128i *)(in + i));
+        __m128i t = _mm_sub_epi8(_mm_or_si128(c, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+        __m128i ones = _mm_and_si128(_mm_cmpeq_epi8(_mm_min_epu8(t, _mm_set1_epi8(25)), t), _mm_set1_epi8(1));
+        __m128i prefix = _mm_add_epi8(ones, _mm_slli_si128(ones, 1));
+        prefix = _mm_add_epi8(prefix, _mm_slli_si128(prefix, 2));
+        prefix = _mm_add_epi8(prefix, _mm_slli_si128(prefix, 4));
+        prefix = _mm_add_epi8(prefix, _mm_slli_si128(prefix, 8));
+        __m128i keys = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(key + k)), _mm_sub_epi8(prefix, ones));
+        _mm_storeu_si128((__m128i *)(out + i), shift16(c, keyShift16(keys, decrypt)));
+        k += (unsigned)_mm_extract_epi16(prefix, 7) >> 8;
+    }
+    return runningScalar(in + i, out + i, len - i, key, k, decrypt);
+}
+#endif
+
+inline size_t countLetters(const char *in, size_t len) {
+#ifdef SHIFT_KERNEL_X86
+    if (best() != Scalar) return countLettersSSE2(in, len);
+#endif
+    return countLettersScalar(in, len);
+}
+
+inline size_t shiftRunning(const char *in, char *out, size_t len, const char *key, size_t k, bool decrypt) {
+#ifdef SHIFT_KERNEL_X86
+    static const bool hasSSSE3 = __builtin_cpu_supports("ssse3");
+    if (hasSSSE3) return runningSSSE3(in, out, len, key, k, decrypt);
+#endif
+    return runningScalar(in, out, len, key, k, decrypt);
+}
+
+// Shift every letter of in[0..len) by shift (in [0, 26)) into out.
+// in and out may be the same buffer.
+inline void shiftUniform(Backend b, const char *in, char *out, size_t len, unsigned shift) {
+#ifdef SHIFT_KERNEL_X86
+    if (b == AVX2) return uniformAVX2(in, out, len, shift);
+    if (b == SSE2) return uniformSSE2(in, out, len, shift);
+#endif
+    (void)b;
+    uniformScalar(in, out, len, shift);
+}
+
+// Shift every letter of in[i] by the key letter key[i] (Vigenere with an
+// already expanded key). Bytes of key at non-letter positions are ignored.
+inline void shiftKeyed(Backend b, const char *in, const char *key, char *out, size_t len, bool decrypt) {
+#ifdef SHIFT_KERNEL_X86
+    if (b == AVX2) return keyedAVX2(in, key, out, len, decrypt);
+    if (b == SSE2) return keyedSSE2(in, key, out, len, decrypt);
+#endif
+    (void)b;
+    keyedScalar(in, key, out, len, decrypt);
+}
+
+inline void shiftUniform(const char *in, char *out, size_t len, unsigned shift) {
+    shiftUniform(best(), in, out, len, shift);
+}
+
+inline void shiftKeyed(const char *in, const char *key, char *out, size_t len, bool decrypt) {
+    shiftKeyed(best(), in, key, out, len, decrypt);
+}
+
+} // namespace shiftkernel
+
+#endif